@@ -8,16 +8,49 @@ in float Height;
 out vec4 FragColor;
 
 uniform sampler2D terrainTexture;
+uniform vec2 gridSize;          // Grid samples in x and z
+
+// Baked visible sky fraction, one texel per grid sample
+uniform bool occlusionEnabled;
+uniform sampler2D occlusionMap;
+
+// Material splatting: the layers of materials blended by the weights in
+// splatMap, one texel per grid sample and four weights per layer
+uniform bool splatEnabled;
+uniform sampler2DArray materials;
+uniform sampler2DArray splatMap;
+uniform int materialCount;
+uniform vec2 materialScale;     // Material repeats across the terrain
+
+vec3 splatColor() {
+    vec2 splatCoords = TexCoords + 0.5 / gridSize;
+    vec4 weights[2];
+    weights[0] = texture(splatMap, vec3(splatCoords, 0.0));
+    weights[1] = materialCount > 4 ? texture(splatMap, vec3(splatCoords, 1.0)) : vec4(0.0);
+
+    vec2 materialCoords = TexCoords * materialScale;
+    vec3 color = vec3(0.0);
+    for (int i = 0; i < materialCount; ++i) {
+        color += texture(materials, vec3(materialCoords, float(i))).rgb * weights[i / 4][i % 4];
+    }
+    return color;
+}
 
 void main() {
-    // Height-based coloring
-    vec3 baseColor;
-    if (Height < 10.0) {
-        baseColor = vec3(0.2, 0.5, 0.2);  // Low ground (green)
-    } else if (Height < 50.0) {
-        baseColor = vec3(0.5, 0.5, 0.2);  // Hills (yellow-ish)
+    vec3 albedo;
+    if (splatEnabled) {
+        albedo = splatColor();
     } else {
-        baseColor = mix(vec3(0.5, 0.5, 0.5), vec3(1.0), (Height - 50.0) / 100.0);  // Mountains (gray to white)
+        // Height-based coloring
+        vec3 baseColor;
+        if (Height < 10.0) {
+            baseColor = vec3(0.2, 0.5, 0.2);  // Low ground (green)
+        } else if (Height < 50.0) {
+            baseColor = vec3(0.5, 0.5, 0.2);  // Hills (yellow-ish)
+        } else {
+            baseColor = mix(vec3(0.5, 0.5, 0.5), vec3(1.0), (Height - 50.0) / 100.0);  // Mountains (gray to white)
+        }
+        albedo = baseColor * texture(terrainTexture, TexCoords).rgb;
     }
 
     // Basic lighting
@@ -26,9 +59,9 @@ void main() {
     float diff = max(dot(normal, -lightDir), 0.0);
     vec3 diffuse = diff * vec3(1.0);
 
-    // Combine lighting with height-based color and texture
-    vec3 texColor = texture(terrainTexture, TexCoords).rgb;
-    vec3 finalColor = baseColor * texColor * (0.3 + 0.7 * diffuse);  // Ambient + diffuse lighting
+    // Occluded ground sees less sky and, mostly, less of the low sun too
+    float occlusion = occlusionEnabled ? texture(occlusionMap, TexCoords + 0.5 / gridSize).r : 1.0;
+    vec3 finalColor = albedo * (0.3 + 0.7 * diffuse) * occlusion;  // Ambient + diffuse lighting
     
     FragColor = vec4(finalColor, 1.0);
 }
@@ -6,6 +6,15 @@ in vec3 TexCoords;
 
 uniform samplerCube skybox;
 
+// Analytic sky: the sun disc, too small for the low-resolution cubemap
+uniform bool sunEnabled;
+uniform vec3 sunDirection;
+
 void main() {    
-    FragColor = texture(skybox, TexCoords);
+    vec3 color = texture(skybox, TexCoords).rgb;
+    if (sunEnabled) {
+        float cosAngle = dot(normalize(TexCoords), sunDirection);
+        color = mix(color, vec3(1.0, 0.97, 0.9), smoothstep(0.9995, 0.9998, cosAngle));
+    }
+    FragColor = vec4(color, 1.0);
 }
\ No newline at end of file
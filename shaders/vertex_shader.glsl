@@ -3,6 +3,12 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
+// GPU heightmap modes: a vertex of the shared patch, and per instance the
+// sample under the patch corner, its level (grid step 1 << level) and
+// its layer of heightTiles
+layout (location = 3) in uvec2 aPatchCoord;
+layout (location = 4) in ivec4 aPatchNode;
+
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
@@ -12,10 +18,92 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// TerrainVertexFormat::Packed: aPos is (grid x, 16-bit height, grid z) and
+// aNormal.xy an octahedral-encoded normal
+uniform bool packedVertices;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+// Heights come from the heightmap texture instead of the vertex buffer
+uniform bool gridPatchEnabled;
+uniform sampler2D heightmap;    // Normalized 16-bit heights
+uniform vec2 heightRange;       // (min height, max - min)
+uniform vec2 heightmapSize;     // Samples in x and z
+uniform vec2 gridCenter;        // Sample that sits at world x = z = 0
+uniform float terrainScale;     // World units between samples
+uniform vec3 cameraPosition;
+uniform vec2 morphConsts[16];   // Per level (end / (end - start), 1 / (end - start))
+
+// TerrainRenderMode::Streaming: heights in metres, one pyramid tile per
+// layer, each starting one sample before the tile corner
+uniform bool streamingEnabled;
+uniform sampler2DArray heightTiles;
+uniform float tileSamples;      // Per side, with the apron
+
+float sampleHeight(vec2 grid) {
+    if (streamingEnabled) {
+        vec2 texel = (grid - vec2(aPatchNode.xy)) / float(1 << aPatchNode.z) + 1.0;
+        return texture(heightTiles, vec3((texel + 0.5) / tileSamples, float(aPatchNode.w))).r;
+    }
+    return heightRange.x + texture(heightmap, (grid + 0.5) / heightmapSize).r * heightRange.y;
+}
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    float t = max(-n.y, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.z += n.z >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 gridToWorld(vec2 grid) {
+    return vec3((grid.x - gridCenter.x) * terrainScale, sampleHeight(grid), (grid.y - gridCenter.y) * terrainScale);
+}
+
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    TexCoords = aTexCoords;
-    Height = aPos.y;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    vec2 texCoords = aTexCoords;
+
+    if (packedVertices) {
+        position = aPos * positionScale + positionOffset;
+        normal = decodeOctahedral(aNormal.xy);
+    }
+
+    if (gridPatchEnabled) {
+        vec2 patchCoord = vec2(aPatchCoord);
+        float nodeStep = float(1 << aPatchNode.z);
+        vec2 morphConst = morphConsts[aPatchNode.z];
+
+        // Patches on the far edges hang over the grid; fold them onto the border
+        vec2 grid = min(vec2(aPatchNode.xy) + patchCoord * nodeStep, heightmapSize - 1.0);
+
+        // 0 near the camera, 1 at the end of this level's range. Odd patch
+        // vertices slide onto their even neighbour, so a fully morphed patch
+        // is exactly the next coarser level and switching levels cannot pop
+        // or leave cracks against a coarser neighbour. Full-resolution
+        // patches use (1, 0) and never morph.
+        float morph = 1.0 - clamp(morphConst.x - distance(cameraPosition, gridToWorld(grid)) * morphConst.y, 0.0, 1.0);
+        grid -= fract(patchCoord * 0.5) * 2.0 * nodeStep * morph;
+        grid = min(grid, heightmapSize - 1.0);
+
+        position = gridToWorld(grid);
+
+        // Central differences, as in Terrain::calculateNormals. Streamed
+        // tiles only hold samples at their own step.
+        float normalStep = streamingEnabled ? nodeStep : 1.0;
+        float left = sampleHeight(grid - vec2(normalStep, 0.0));
+        float right = sampleHeight(grid + vec2(normalStep, 0.0));
+        float up = sampleHeight(grid - vec2(0.0, normalStep));
+        float down = sampleHeight(grid + vec2(0.0, normalStep));
+        normal = normalize(vec3(left - right, 2.0 * normalStep * terrainScale, up - down));
+
+        texCoords = grid / heightmapSize;
+    }
+
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(model))) * normal;
+    TexCoords = texCoords;
+    Height = position.y;
+    gl_Position = projection * view * model * vec4(position, 1.0);
 }
@@ -0,0 +1,165 @@
+// area_cache.cpp
+#include "area_cache.h"
+#include "hiking_data.h"
+#include <iostream>
+#include <limits>
+
+AreaCache::AreaCache(size_t budgetBytes) {
+    stats.budgetBytes = budgetBytes;
+}
+
+Area* AreaCache::acquire(const AreaDescription& description) {
+    auto it = areas.find(description.name);
+    if (it != areas.end()) {
+        // The first hand-out after a load was already counted as a miss
+        if (!it->second->fresh) {
+            ++stats.hits;
+        }
+        return use(*it->second);
+    }
+
+    if (pending || failedNames.count(description.name)) {
+        return nullptr;
+    }
+    ++stats.misses;
+    std::unique_ptr<Area> area = startArea(description);
+    if (!area || !loader.start(description.heightMapPath, description.texturePath, area->hikingData, description.settings)) {
+        failedNames.insert(description.name);
+        return nullptr;
+    }
+    pending = std::move(area);
+    return nullptr;
+}
+
+Area* AreaCache::load(const AreaDescription& description) {
+    auto it = areas.find(description.name);
+    if (it != areas.end()) {
+        return acquire(description);
+    }
+
+    ++stats.misses;
+    std::unique_ptr<Area> area = startArea(description);
+    if (!area) {
+        return nullptr;
+    }
+    area->terrain = std::make_unique<Terrain>();
+    if (!area->terrain->initialize(description.heightMapPath, description.texturePath, area->hikingData, description.settings)) {
+        std::cerr << "Failed to initialize terrain for area " << description.name << std::endl;
+        return nullptr;
+    }
+    if (!finishArea(*area)) {
+        return nullptr;
+    }
+
+    Area* loaded = area.get();
+    insert(std::move(area));
+    return use(*loaded);
+}
+
+void AreaCache::update(double uploadBudgetMs) {
+    if (!pending) return;
+
+    std::unique_ptr<Terrain> terrain = loader.update(uploadBudgetMs);
+    if (!terrain) {
+        if (!loader.isLoading()) {
+            // The loader has reported why
+            failedNames.insert(pending->name);
+            pending.reset();
+        }
+        return;
+    }
+
+    pending->terrain = std::move(terrain);
+    std::unique_ptr<Area> area = std::move(pending);
+    if (areas.count(area->name)) {
+        return;     // load() got there first
+    }
+    if (!finishArea(*area)) {
+        failedNames.insert(area->name);
+        return;
+    }
+    insert(std::move(area));
+}
+
+void AreaCache::printStats() const {
+    std::cout << "Area cache: " << stats.residentAreas << " area(s), "
+        << stats.residentBytes / (1024 * 1024) << "/" << stats.budgetBytes / (1024 * 1024) << " MB, "
+        << stats.hits << " hit(s), " << stats.misses << " miss(es), "
+        << stats.evictions << " eviction(s)" << std::endl;
+}
+
+void AreaCache::clear() {
+    // An area still loading would otherwise be inserted after the clear
+    loader.cancel();
+    pending.reset();
+    areas.clear();
+    failedNames.clear();
+    currentName.clear();
+    stats.residentAreas = 0;
+    stats.residentBytes = 0;
+}
+
+std::unique_ptr<Area> AreaCache::startArea(const AreaDescription& description) {
+    auto area = std::make_unique<Area>();
+    area->name = description.name;
+    HikeTrack track;
+    if (!loadHikeTrackCached(description.gpxPath, description.settings.meshCacheDirectory, track)) {
+        std::cerr << "Failed to load hiking data for area " << description.name << std::endl;
+        return nullptr;
+    }
+    area->hikingData.swap(track.positions);
+    return area;
+}
+
+bool AreaCache::finishArea(Area& area) {
+    area.visualizer = std::make_unique<HikingVisualizer>();
+    if (!area.visualizer->initialize(area.hikingData)) {
+        std::cerr << "Failed to initialize hiking visualizer for area " << area.name << std::endl;
+        return false;
+    }
+    area.gpuBytes = area.terrain->getGpuBytes() + area.visualizer->getGpuBytes();
+    return true;
+}
+
+Area* AreaCache::use(Area& area) {
+    area.lastUsed = ++useCounter;
+    area.fresh = false;
+    currentName = area.name;
+    return &area;
+}
+
+void AreaCache::insert(std::unique_ptr<Area> area) {
+    // Counts as used now, so it is not the first to go
+    area->lastUsed = ++useCounter;
+    const std::string name = area->name;
+    stats.residentBytes += area->gpuBytes;
+    areas[name] = std::move(area);
+    stats.residentAreas = areas.size();
+    evict(name);
+    printStats();
+}
+
+void AreaCache::evict(const std::string& keep) {
+    while (stats.residentBytes > stats.budgetBytes) {
+        auto oldest = areas.end();
+        uint64_t oldestUse = std::numeric_limits<uint64_t>::max();
+        for (auto it = areas.begin(); it != areas.end(); ++it) {
+            if (it->first == keep || it->first == currentName) continue;
+            if (it->second->lastUsed < oldestUse) {
+                oldestUse = it->second->lastUsed;
+                oldest = it;
+            }
+        }
+        if (oldest == areas.end()) {
+            std::cerr << "Areas in use exceed the area cache budget" << std::endl;
+            return;
+        }
+
+        std::cout << "Evicting area " << oldest->first << " ("
+            << oldest->second->gpuBytes / (1024 * 1024) << " MB)" << std::endl;
+        stats.residentBytes -= oldest->second->gpuBytes;
+        areas.erase(oldest);
+        stats.residentAreas = areas.size();
+        ++stats.evictions;
+    }
+}
@@ -0,0 +1,90 @@
+// area_cache.h
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glm/glm.hpp>
+#include "terrain.h"
+#include "terrain_loader.h"
+#include "hiking_visualizer.h"
+
+// Everything needed to show one region: a height map, its texture and the
+// hike drawn on it. The name identifies the area in the cache.
+struct AreaDescription {
+    std::string name;
+    std::string heightMapPath;
+    std::string texturePath;
+    std::string gpxPath;
+    TerrainSettings settings;
+};
+
+// A loaded area with all of its GPU resources
+struct Area {
+    std::string name;
+    std::vector<glm::vec3> hikingData;
+    std::unique_ptr<Terrain> terrain;
+    std::unique_ptr<HikingVisualizer> visualizer;
+    size_t gpuBytes{ 0 };
+    uint64_t lastUsed{ 0 };
+    bool fresh{ true };         // Not handed out since it was loaded
+};
+
+// Keeps recently used areas on the GPU so switching back to one is
+// immediate instead of a full reload. Areas are loaded in the background
+// (see TerrainLoader) and the least recently used ones are evicted once
+// the resident areas exceed the video memory budget. The area handed out
+// last is never evicted, so the one on screen stays valid.
+class AreaCache {
+public:
+    struct Stats {
+        size_t hits{ 0 };           // acquire() found the area resident
+        size_t misses{ 0 };         // acquire() or load() had to load it
+        size_t evictions{ 0 };
+        size_t residentAreas{ 0 };
+        size_t residentBytes{ 0 };
+        size_t budgetBytes{ 0 };
+    };
+
+    explicit AreaCache(size_t budgetBytes);
+
+    // Delete copy constructor and assignment operator
+    AreaCache(const AreaCache&) = delete;
+    AreaCache& operator=(const AreaCache&) = delete;
+
+    // The area if it is resident. Otherwise starts loading it in the
+    // background and returns nullptr; keep asking, it is returned once
+    // update() has finished it. Only one area loads at a time.
+    Area* acquire(const AreaDescription& description);
+
+    // Like acquire, but loads a missing area right away. For startup.
+    Area* load(const AreaDescription& description);
+
+    // Call once per frame on the GL thread: advances the background load
+    // by at most budgetMs of uploads and evicts areas over the budget
+    void update(double uploadBudgetMs);
+
+    bool isLoading() const { return loader.isLoading(); }
+    bool isResident(const std::string& name) const { return areas.count(name) != 0; }
+    const Stats& getStats() const { return stats; }
+    void printStats() const;
+    // Drops every area, including one still loading
+    void clear();
+
+private:
+    std::unordered_map<std::string, std::unique_ptr<Area>> areas;
+    std::unique_ptr<Area> pending;      // Loading; its terrain comes from loader
+    TerrainLoader loader;
+    std::unordered_set<std::string> failedNames;    // Not retried until clear()
+    std::string currentName;            // Last area handed out
+    uint64_t useCounter{ 0 };
+    Stats stats;
+
+    std::unique_ptr<Area> startArea(const AreaDescription& description);
+    bool finishArea(Area& area);
+    Area* use(Area& area);
+    void insert(std::unique_ptr<Area> area);
+    void evict(const std::string& keep);
+};
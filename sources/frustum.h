@@ -0,0 +1,53 @@
+// frustum.h
+#pragma once
+#include <glm/glm.hpp>
+
+// View frustum as six inward-facing planes (a, b, c, d) with ax + by + cz + d >= 0 inside
+struct Frustum {
+    enum Plane { PLANE_LEFT = 0, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+    glm::vec4 planes[PLANE_COUNT];
+
+    // Gribb/Hartmann plane extraction from a projection * view matrix
+    static Frustum fromMatrix(const glm::mat4& viewProjection) {
+        // glm is column-major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        auto row = [&](int i) {
+            return glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                viewProjection[2][i], viewProjection[3][i]);
+        };
+
+        Frustum frustum;
+        frustum.planes[PLANE_LEFT] = row(3) + row(0);
+        frustum.planes[PLANE_RIGHT] = row(3) - row(0);
+        frustum.planes[PLANE_BOTTOM] = row(3) + row(1);
+        frustum.planes[PLANE_TOP] = row(3) - row(1);
+        frustum.planes[PLANE_NEAR] = row(3) + row(2);
+        frustum.planes[PLANE_FAR] = row(3) - row(2);
+
+        for (auto& plane : frustum.planes) {
+            plane = plane / glm::length(glm::vec3(plane.x, plane.y, plane.z));
+        }
+        return frustum;
+    }
+
+    // Conservative test: false only if the box is fully outside one plane
+    bool intersectsAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const {
+        for (const auto& plane : planes) {
+            // Corner furthest along the plane normal
+            glm::vec3 corner(plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+                plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+                plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+            if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// True if the sphere reaches the box; used for LOD distance ranges
+inline bool sphereIntersectsAABB(const glm::vec3& center, float radius,
+    const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 closest = glm::max(boundsMin, glm::min(center, boundsMax));
+    glm::vec3 delta = closest - center;
+    return glm::dot(delta, delta) <= radius * radius;
+}
@@ -0,0 +1,102 @@
+// gpx_reader.cpp
+#include "gpx_reader.h"
+#include <iostream>
+#include "text_parse.h"
+
+namespace {
+    // The whole element or attribute text must be the number, so "12,5" or
+    // "68.4abc" count as missing instead of as 12 or 68.4
+    bool parseValue(const XmlSpan& text, double& value) {
+        const char* p = nullptr;
+        if (!parseDecimal(text.begin, text.end, value, &p)) return false;
+        while (p < text.end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+        return p == text.end;
+    }
+}
+
+bool GpxReader::open(const std::string& filePath) {
+    path = filePath;
+    parseFailed = false;
+    skippedPoints = 0;
+    if (!file.open(filePath)) {
+        parser.reset();
+        return false;
+    }
+    parser = std::make_unique<XmlPullParser>(reinterpret_cast<const char*>(file.data()), file.size());
+    return true;
+}
+
+bool GpxReader::next(GpxTrackPoint& point) {
+    if (!parser) return false;
+
+    bool inPoint = false;
+    bool pointValid = false;
+    Field field = Field::None;
+    for (;;) {
+        switch (parser->next()) {
+        case XmlPullParser::Event::StartElement: {
+            XmlSpan name = parser->getLocalName();
+            if (!inPoint) {
+                if (!name.equals("trkpt")) break;
+                inPoint = true;
+                point = GpxTrackPoint();
+                XmlSpan lat, lon;
+                pointValid = parser->getAttribute("lat", lat) && parser->getAttribute("lon", lon) &&
+                    parseValue(lat, point.latitude) && parseValue(lon, point.longitude);
+            }
+            else {
+                // Extensions by local name, whatever prefix the file binds
+                field = name.equals("ele") ? Field::Elevation
+                    : name.equals("time") ? Field::Time
+                    : name.equals("hr") ? Field::HeartRate
+                    : name.equals("cad") ? Field::Cadence
+                    : name.equals("atemp") ? Field::Temperature
+                    : Field::None;
+            }
+            break;
+        }
+        case XmlPullParser::Event::Text: {
+            XmlSpan text = parser->getText();
+            double value = 0.0;
+            switch (field) {
+            case Field::Elevation:
+                point.hasElevation = parseValue(text, point.elevation);
+                break;
+            case Field::Time:
+                point.hasTime = parseIso8601Time(text.begin, text.end, point.time);
+                break;
+            case Field::HeartRate:
+                point.hasHeartRate = parseValue(text, value);
+                point.heartRate = static_cast<float>(value);
+                break;
+            case Field::Cadence:
+                point.hasCadence = parseValue(text, value);
+                point.cadence = static_cast<float>(value);
+                break;
+            case Field::Temperature:
+                point.hasTemperature = parseValue(text, value);
+                point.temperature = static_cast<float>(value);
+                break;
+            case Field::None:
+                break;
+            }
+            break;
+        }
+        case XmlPullParser::Event::EndElement:
+            field = Field::None;
+            if (inPoint && parser->getLocalName().equals("trkpt")) {
+                inPoint = false;
+                if (pointValid) return true;
+                ++skippedPoints;
+            }
+            break;
+        case XmlPullParser::Event::EndOfDocument:
+            return false;
+        case XmlPullParser::Event::Error:
+            std::cerr << "GPX parse error in " << path << " at byte " << parser->getOffset() << ": "
+                << parser->getError() << std::endl;
+            parseFailed = true;
+            return false;
+        }
+    }
+}
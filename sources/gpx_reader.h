@@ -0,0 +1,49 @@
+// gpx_reader.h
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "mapped_file.h"
+#include "xml_pull_parser.h"
+
+struct GpxTrackPoint {
+    double latitude{ 0.0 };     // Degrees
+    double longitude{ 0.0 };
+    double elevation{ 0.0 };    // Metres; 0 without <ele>
+    double time{ 0.0 };         // Seconds since the Unix epoch; 0 without <time>
+
+    // From the Garmin TrackPointExtension (gpxtpx:hr, cad and atemp)
+    float heartRate{ 0.0f };    // Beats per minute
+    float cadence{ 0.0f };      // Per minute
+    float temperature{ 0.0f };  // Degrees Celsius
+
+    bool hasElevation{ false };
+    bool hasTime{ false };
+    bool hasHeartRate{ false };
+    bool hasCadence{ false };
+    bool hasTemperature{ false };
+};
+
+// Streams the track points (<trkpt>) of a GPX file, of every track and
+// segment in document order, in a single pass over the memory-mapped file.
+// Nothing is kept per point, so any file size reads in constant memory.
+class GpxReader {
+public:
+    bool open(const std::string& path);
+
+    // Next track point; false at the end of the file or on a parse error
+    bool next(GpxTrackPoint& point);
+
+    bool failed() const { return parseFailed; }
+    size_t getFileSize() const { return file.size(); }
+    size_t getSkippedPoints() const { return skippedPoints; }  // Without lat or lon
+
+private:
+    enum class Field { None, Elevation, Time, HeartRate, Cadence, Temperature };
+
+    MappedFile file;
+    std::unique_ptr<XmlPullParser> parser;
+    std::string path;
+    bool parseFailed{ false };
+    size_t skippedPoints{ 0 };
+};
@@ -0,0 +1,105 @@
+// grid_normals.cpp
+#include "grid_normals.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GRID_NORMALS_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GRID_NORMALS_SSE2 1
+#endif
+
+namespace {
+    // The gradient (gx, gz) is -dh/dx and -dh/dz, so the unnormalized normal
+    // is (gx, 1, gz). The SIMD paths use the same operation order, which
+    // keeps them bit-identical to this scalar version.
+    inline void storeNormal(float gx, float gz, int x, float* outX, float* outY, float* outZ) {
+        float invLength = 1.0f / std::sqrt((gx * gx + 1.0f) + gz * gz);
+        outX[x] = gx * invLength;
+        outY[x] = invLength;
+        outZ[x] = gz * invLength;
+    }
+
+#if GRID_NORMALS_SSE2
+    inline void normals4(const float* row, const float* up, const float* down, int x,
+        __m128 invSpanX, __m128 invSpanZ, float* outX, float* outY, float* outZ) {
+        __m128 gx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x - 1), _mm_loadu_ps(row + x + 1)), invSpanX);
+        __m128 gz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x)), invSpanZ);
+        __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_set1_ps(1.0f)), _mm_mul_ps(gz, gz));
+        __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSq));
+        _mm_storeu_ps(outX + x, _mm_mul_ps(gx, invLength));
+        _mm_storeu_ps(outY + x, invLength);
+        _mm_storeu_ps(outZ + x, _mm_mul_ps(gz, invLength));
+    }
+#endif
+
+#if GRID_NORMALS_AVX2
+    inline void normals8(const float* row, const float* up, const float* down, int x,
+        __m256 invSpanX, __m256 invSpanZ, float* outX, float* outY, float* outZ) {
+        __m256 gx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row + x - 1), _mm256_loadu_ps(row + x + 1)), invSpanX);
+        __m256 gz = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(down + x)), invSpanZ);
+        __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_set1_ps(1.0f)), _mm256_mul_ps(gz, gz));
+        __m256 invLength = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lengthSq));
+        _mm256_storeu_ps(outX + x, _mm256_mul_ps(gx, invLength));
+        _mm256_storeu_ps(outY + x, invLength);
+        _mm256_storeu_ps(outZ + x, _mm256_mul_ps(gz, invLength));
+    }
+#endif
+}
+
+void computeGridNormalRow(const float* heights, int width, int height, float spacing,
+    int z, float* outX, float* outY, float* outZ) {
+    // Neighbouring rows, clamped to the grid (one-sided difference on the border)
+    int zUp = std::max(z - 1, 0);
+    int zDown = std::min(z + 1, height - 1);
+    const float* row = heights + static_cast<size_t>(z) * width;
+    const float* up = heights + static_cast<size_t>(zUp) * width;
+    const float* down = heights + static_cast<size_t>(zDown) * width;
+
+    const float invSpanZ = zDown > zUp ? 1.0f / ((zDown - zUp) * spacing) : 0.0f;
+    const float invSpanInterior = 1.0f / (2.0f * spacing);
+    const float invSpanEdge = 1.0f / spacing;
+
+    if (width == 1) {
+        storeNormal(0.0f, (up[0] - down[0]) * invSpanZ, 0, outX, outY, outZ);
+        return;
+    }
+
+    storeNormal((row[0] - row[1]) * invSpanEdge, (up[0] - down[0]) * invSpanZ, 0, outX, outY, outZ);
+
+    // Interior columns [1, width - 1) use central differences
+    int x = 1;
+    const int end = width - 1;
+
+#if GRID_NORMALS_AVX2
+    {
+        const __m256 spanX = _mm256_set1_ps(invSpanInterior);
+        const __m256 spanZ = _mm256_set1_ps(invSpanZ);
+        for (; x + 16 <= end; x += 16) {
+            normals8(row, up, down, x, spanX, spanZ, outX, outY, outZ);
+            normals8(row, up, down, x + 8, spanX, spanZ, outX, outY, outZ);
+        }
+    }
+#endif
+#if GRID_NORMALS_SSE2
+    {
+        const __m128 spanX = _mm_set1_ps(invSpanInterior);
+        const __m128 spanZ = _mm_set1_ps(invSpanZ);
+        for (; x + 8 <= end; x += 8) {
+            normals4(row, up, down, x, spanX, spanZ, outX, outY, outZ);
+            normals4(row, up, down, x + 4, spanX, spanZ, outX, outY, outZ);
+        }
+        for (; x + 4 <= end; x += 4) {
+            normals4(row, up, down, x, spanX, spanZ, outX, outY, outZ);
+        }
+    }
+#endif
+    for (; x < end; ++x) {
+        storeNormal((row[x - 1] - row[x + 1]) * invSpanInterior, (up[x] - down[x]) * invSpanZ, x, outX, outY, outZ);
+    }
+
+    storeNormal((row[end - 1] - row[end]) * invSpanEdge, (up[end] - down[end]) * invSpanZ, end, outX, outY, outZ);
+}
@@ -0,0 +1,13 @@
+// grid_normals.h
+#pragma once
+
+// Normals of a regular height grid (row-major, spacing world units between
+// samples) computed from central differences of the heights, with one-sided
+// differences along the border. Only the height grid is read, so rows are
+// independent and the inner loop runs 8 (SSE2) or 16 (AVX2) vertices per
+// iteration.
+//
+// For row z, writes the unit normal of every vertex as separate x/y/z planes
+// of width floats each.
+void computeGridNormalRow(const float* heights, int width, int height, float spacing,
+    int z, float* outX, float* outY, float* outZ);
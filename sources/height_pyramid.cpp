@@ -0,0 +1,246 @@
+// height_pyramid.cpp
+#include "height_pyramid.h"
+#include "height_sampler.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace {
+    constexpr char PYRAMID_MAGIC[8] = { 'H', 'G', 'T', 'P', 'Y', 'R', 'A', 'M' };
+    constexpr uint32_t PYRAMID_VERSION = 1;
+
+    // Tiles are 16-bit indexed patches on the GPU, (tileSize + 1)^2 vertices
+    constexpr int MAX_TILE_SIZE = 254;
+
+    struct PyramidHeader {
+        char magic[8];
+        uint32_t version;
+        int32_t width;
+        int32_t height;
+        int32_t tileSize;
+        int32_t levelCount;
+        float minHeight;
+        float maxHeight;
+        uint32_t reserved;
+        uint64_t tileCount;
+        uint64_t rangesOffset;      // tileCount (min, max) float pairs
+        uint64_t dataOffset;        // tileCount tiles of (tileSize + 3)^2 floats
+    };
+
+    struct LevelSize {
+        int tilesX;
+        int tilesZ;
+    };
+
+    // Levels until one tile covers the grid
+    std::vector<LevelSize> levelSizes(int width, int height, int tileSize) {
+        std::vector<LevelSize> sizes;
+        int quadsX = width - 1;
+        int quadsZ = height - 1;
+        for (;;) {
+            LevelSize size{ std::max((quadsX + tileSize - 1) / tileSize, 1), std::max((quadsZ + tileSize - 1) / tileSize, 1) };
+            sizes.push_back(size);
+            if (size.tilesX == 1 && size.tilesZ == 1) break;
+            quadsX = (quadsX + 1) / 2;
+            quadsZ = (quadsZ + 1) / 2;
+        }
+        return sizes;
+    }
+}
+
+bool HeightPyramid::build(const std::string& path, int width, int height, int tileSize,
+    const RegionReader& reader) {
+    if (width < 2 || height < 2 || tileSize < 2 || tileSize > MAX_TILE_SIZE) {
+        std::cerr << "Invalid height pyramid size " << width << "x" << height
+            << " with tiles of " << tileSize << std::endl;
+        return false;
+    }
+
+    const std::vector<LevelSize> sizes = levelSizes(width, height, tileSize);
+    uint64_t tileCount = 0;
+    for (const auto& size : sizes) {
+        tileCount += static_cast<uint64_t>(size.tilesX) * size.tilesZ;
+    }
+
+    PyramidHeader header{};
+    std::memcpy(header.magic, PYRAMID_MAGIC, sizeof(PYRAMID_MAGIC));
+    header.version = PYRAMID_VERSION;
+    header.width = width;
+    header.height = height;
+    header.tileSize = tileSize;
+    header.levelCount = static_cast<int32_t>(sizes.size());
+    header.tileCount = tileCount;
+    header.rangesOffset = sizeof(PyramidHeader);
+    header.dataOffset = (header.rangesOffset + tileCount * sizeof(glm::vec2) + 15) / 16 * 16;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to create height pyramid: " << path << std::endl;
+        return false;
+    }
+
+    // Ranges are only known once the tiles are written; tiles go straight
+    // to their final offsets
+    std::vector<glm::vec2> ranges(tileCount);
+    const int samples = tileSize + 3;
+    std::vector<float> tile(static_cast<size_t>(samples) * samples);
+    float globalMin = std::numeric_limits<float>::max();
+    float globalMax = std::numeric_limits<float>::lowest();
+
+    out.seekp(static_cast<std::streamoff>(header.dataOffset));
+    uint64_t firstTile = 0;
+    for (size_t level = 0; level < sizes.size(); ++level) {
+        const int step = 1 << level;
+        const LevelSize& size = sizes[level];
+        for (int tz = 0; tz < size.tilesZ; ++tz) {
+            for (int tx = 0; tx < size.tilesX; ++tx) {
+                // Apron: one sample before and two after the tile's tileSize quads
+                reader((tx * tileSize - 1) * step, (tz * tileSize - 1) * step, step, samples, samples, tile.data());
+                out.write(reinterpret_cast<const char*>(tile.data()), static_cast<std::streamsize>(tile.size() * sizeof(float)));
+
+                // Range over the tile's own quads, widened by its children below
+                glm::vec2 range(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+                for (int z = 1; z <= tileSize + 1; ++z) {
+                    for (int x = 1; x <= tileSize + 1; ++x) {
+                        float h = tile[static_cast<size_t>(z) * samples + x];
+                        range.x = std::min(range.x, h);
+                        range.y = std::max(range.y, h);
+                    }
+                }
+                if (level > 0) {
+                    const LevelSize& children = sizes[level - 1];
+                    uint64_t childFirst = firstTile - static_cast<uint64_t>(children.tilesX) * children.tilesZ;
+                    for (int cz = tz * 2; cz < std::min(tz * 2 + 2, children.tilesZ); ++cz) {
+                        for (int cx = tx * 2; cx < std::min(tx * 2 + 2, children.tilesX); ++cx) {
+                            const glm::vec2& child = ranges[childFirst + static_cast<uint64_t>(cz) * children.tilesX + cx];
+                            range.x = std::min(range.x, child.x);
+                            range.y = std::max(range.y, child.y);
+                        }
+                    }
+                }
+                ranges[firstTile + static_cast<uint64_t>(tz) * size.tilesX + tx] = range;
+                globalMin = std::min(globalMin, range.x);
+                globalMax = std::max(globalMax, range.y);
+            }
+        }
+        firstTile += static_cast<uint64_t>(size.tilesX) * size.tilesZ;
+    }
+
+    header.minHeight = globalMin;
+    header.maxHeight = globalMax;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(ranges.data()), static_cast<std::streamsize>(ranges.size() * sizeof(glm::vec2)));
+    if (!out) {
+        std::cerr << "Failed to write height pyramid: " << path << std::endl;
+        return false;
+    }
+
+    std::cout << "Height pyramid " << path << ": " << width << "x" << height << ", "
+        << sizes.size() << " levels, " << tileCount << " tiles" << std::endl;
+    return true;
+}
+
+bool HeightPyramid::buildFromRawFile(const std::string& path, const std::string& rawPath,
+    int width, int height, int tileSize) {
+    MappedFile raw;
+    if (!raw.open(rawPath) || raw.size() < static_cast<size_t>(width) * height * sizeof(float)) {
+        std::cerr << "Failed to map raw height grid: " << rawPath << std::endl;
+        return false;
+    }
+
+    const float* heights = reinterpret_cast<const float*>(raw.data());
+    return build(path, width, height, tileSize, [&](int x0, int z0, int step, int countX, int countZ, float* out) {
+        for (int z = 0; z < countZ; ++z) {
+            size_t row = static_cast<size_t>(std::min(std::max(z0 + z * step, 0), height - 1)) * width;
+            for (int x = 0; x < countX; ++x) {
+                *out++ = heights[row + std::min(std::max(x0 + x * step, 0), width - 1)];
+            }
+        }
+    });
+}
+
+bool HeightPyramid::open(const std::string& path) {
+    close();
+    if (!file.open(path)) {
+        std::cerr << "Failed to open height pyramid: " << path << std::endl;
+        return false;
+    }
+
+    PyramidHeader header;
+    bool valid = file.size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, file.data(), sizeof(header));
+        valid = std::memcmp(header.magic, PYRAMID_MAGIC, sizeof(PYRAMID_MAGIC)) == 0 &&
+            header.version == PYRAMID_VERSION && header.width >= 2 && header.height >= 2 &&
+            header.tileSize >= 2 && header.tileSize <= MAX_TILE_SIZE;
+    }
+    if (valid) {
+        // tileCount is bounded by division, so a huge one cannot wrap into
+        // passing, and the grid has to fit its leaf tiles before levelSizes
+        const uint64_t tileBytes = static_cast<uint64_t>(header.tileSize + 3) * (header.tileSize + 3) * sizeof(float);
+        valid = header.rangesOffset >= sizeof(header) && header.rangesOffset <= header.dataOffset &&
+            header.dataOffset <= file.size() &&
+            header.tileCount <= (header.dataOffset - header.rangesOffset) / sizeof(glm::vec2) &&
+            header.tileCount <= (file.size() - header.dataOffset) / tileBytes &&
+            static_cast<uint64_t>(header.width - 1) <= header.tileCount * header.tileSize &&
+            static_cast<uint64_t>(header.height - 1) <= header.tileCount * header.tileSize;
+    }
+    if (!valid) {
+        std::cerr << "Invalid height pyramid: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    width = header.width;
+    height = header.height;
+    tileSize = header.tileSize;
+    minHeight = header.minHeight;
+    maxHeight = header.maxHeight;
+    uint64_t firstTile = 0;
+    for (const auto& size : levelSizes(width, height, tileSize)) {
+        levels.push_back({ size.tilesX, size.tilesZ, firstTile });
+        firstTile += static_cast<uint64_t>(size.tilesX) * size.tilesZ;
+    }
+    // The tiles of every level have to be there, or tile lookups would
+    // read past the mapping
+    if (static_cast<int32_t>(levels.size()) != header.levelCount || firstTile != header.tileCount) {
+        std::cerr << "Invalid height pyramid: " << path << std::endl;
+        close();
+        return false;
+    }
+    tileRanges = reinterpret_cast<const glm::vec2*>(file.data() + header.rangesOffset);
+    tileData = reinterpret_cast<const float*>(file.data() + header.dataOffset);
+    return true;
+}
+
+void HeightPyramid::close() {
+    file.close();
+    levels.clear();
+    tileRanges = nullptr;
+    tileData = nullptr;
+    width = height = tileSize = 0;
+}
+
+glm::vec2 HeightPyramid::getTileRange(int level, int tileX, int tileZ) const {
+    return tileRanges[tileIndex(level, tileX, tileZ)];
+}
+
+const float* HeightPyramid::getTileData(int level, int tileX, int tileZ) const {
+    const size_t tileFloats = static_cast<size_t>(getTileSamples()) * getTileSamples();
+    return tileData + tileIndex(level, tileX, tileZ) * tileFloats;
+}
+
+float HeightPyramid::sampleHeight(float gridX, float gridZ) const {
+    gridX = std::min(std::max(0.0f, gridX), static_cast<float>(width - 1));
+    gridZ = std::min(std::max(0.0f, gridZ), static_cast<float>(height - 1));
+
+    // The apron holds two samples past the tile's far edge, so the whole
+    // bilinear footprint is inside one tile
+    int tileX = std::min(static_cast<int>(gridX) / tileSize, levels[0].tilesX - 1);
+    int tileZ = std::min(static_cast<int>(gridZ) / tileSize, levels[0].tilesZ - 1);
+    return sampleGridHeight(getTileData(0, tileX, tileZ), getTileSamples(), getTileSamples(),
+        gridX - tileX * tileSize + 1.0f, gridZ - tileZ * tileSize + 1.0f);
+}
@@ -0,0 +1,81 @@
+// height_pyramid.h
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mapped_file.h"
+
+// Tiled multi-resolution height grid on disk, for terrains too large to
+// hold in memory. Level 0 is the full grid; each coarser level keeps every
+// other sample (decimation, not averaging, so a coarse sample equals the
+// fine one at the same spot and LOD morphing stays crack-free). Every level
+// is cut into tiles of tileSize quads, stored with a one-sample apron so
+// normals can be taken inside a single tile.
+//
+// The file is read through a memory mapping: only the tiles actually
+// touched are paged in, and the OS can drop them again at any time.
+class HeightPyramid {
+public:
+    // Fills countX x countZ samples starting at (x0, z0), taking every
+    // step-th sample, into out (row-major). Coordinates past the grid must
+    // be clamped to it.
+    using RegionReader = std::function<void(int x0, int z0, int step, int countX, int countZ, float* out)>;
+
+    // Writes a pyramid tile by tile; memory use is a few tiles regardless
+    // of the grid size
+    static bool build(const std::string& path, int width, int height, int tileSize,
+        const RegionReader& reader);
+
+    // A headerless little-endian float32 file of width * height samples,
+    // mapped rather than read, as the source of build()
+    static bool buildFromRawFile(const std::string& path, const std::string& rawPath,
+        int width, int height, int tileSize);
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return file.isOpen(); }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getTileSize() const { return tileSize; }
+    int getTileSamples() const { return tileSize + 3; }   // Per side, with the apron
+    int getLevelCount() const { return static_cast<int>(levels.size()); }
+    int getTilesX(int level) const { return levels[level].tilesX; }
+    int getTilesZ(int level) const { return levels[level].tilesZ; }
+    float getMinHeight() const { return minHeight; }
+    float getMaxHeight() const { return maxHeight; }
+
+    // (min, max) height over the tile and all finer tiles below it
+    glm::vec2 getTileRange(int level, int tileX, int tileZ) const;
+
+    // getTileSamples()^2 heights, row-major, starting one sample before the
+    // tile's first corner
+    const float* getTileData(int level, int tileX, int tileZ) const;
+
+    // Bilinear full-resolution height at grid coordinates, from the level 0
+    // tile under them. Clamped to the grid like sampleGridHeight.
+    float sampleHeight(float gridX, float gridZ) const;
+
+private:
+    struct Level {
+        int tilesX{ 0 };
+        int tilesZ{ 0 };
+        uint64_t firstTile{ 0 };    // Index of the level's first tile in the file
+    };
+
+    MappedFile file;
+    int width{ 0 };
+    int height{ 0 };
+    int tileSize{ 0 };
+    float minHeight{ 0.0f };
+    float maxHeight{ 0.0f };
+    std::vector<Level> levels;
+    const glm::vec2* tileRanges{ nullptr };    // Per tile, in the mapped file
+    const float* tileData{ nullptr };          // First tile, in the mapped file
+
+    uint64_t tileIndex(int level, int tileX, int tileZ) const {
+        return levels[level].firstTile + static_cast<uint64_t>(tileZ) * levels[level].tilesX + tileX;
+    }
+};
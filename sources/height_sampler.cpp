@@ -0,0 +1,146 @@
+// height_sampler.cpp
+#include "height_sampler.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HEIGHT_SAMPLER_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEIGHT_SAMPLER_SSE2 1
+#endif
+
+namespace {
+    // Cell (x0, z0) and the fractions inside it. The last row and column
+    // belong to the cell before them, so x0 + 1 and z0 + 1 stay in the grid.
+    // The clamp sends NaN to 0, like _mm_max_ps with zero second.
+    inline float bilinear(const float* heights, int width, float maxX, float maxZ,
+        float maxCellX, float maxCellZ, float gx, float gz) {
+        gx = std::min(std::max(0.0f, gx), maxX);
+        gz = std::min(std::max(0.0f, gz), maxZ);
+        float cellX = std::min(static_cast<float>(static_cast<int>(gx)), maxCellX);
+        float cellZ = std::min(static_cast<float>(static_cast<int>(gz)), maxCellZ);
+        float fx = gx - cellX;
+        float fz = gz - cellZ;
+
+        const float* row0 = heights + static_cast<size_t>(cellZ) * width + static_cast<size_t>(cellX);
+        const float* row1 = row0 + width;
+        float top = row0[0] + (row0[1] - row0[0]) * fx;
+        float bottom = row1[0] + (row1[1] - row1[0]) * fx;
+        return top + (bottom - top) * fz;
+    }
+
+#if HEIGHT_SAMPLER_SSE2
+    inline __m128 lerp4(__m128 a, __m128 b, __m128 t) {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+    }
+#endif
+
+#if HEIGHT_SAMPLER_AVX2
+    inline __m256 lerp8(__m256 a, __m256 b, __m256 t) {
+        return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+    }
+#endif
+}
+
+float sampleGridHeight(const float* heights, int width, int height, float gridX, float gridZ) {
+    return bilinear(heights, width, static_cast<float>(width - 1), static_cast<float>(height - 1),
+        static_cast<float>(width - 2), static_cast<float>(height - 2), gridX, gridZ);
+}
+
+void sampleGridHeights(const float* heights, int width, int height,
+    float invSpacing, const glm::vec2& offset,
+    const glm::vec2* positions, float* out, size_t count) {
+    const float maxX = static_cast<float>(width - 1);
+    const float maxZ = static_cast<float>(height - 1);
+    const float maxCellX = static_cast<float>(width - 2);
+    const float maxCellZ = static_cast<float>(height - 2);
+    const float* coords = reinterpret_cast<const float*>(positions);
+    size_t i = 0;
+
+#if HEIGHT_SAMPLER_AVX2
+    {
+        const __m256 scale = _mm256_set1_ps(invSpacing);
+        const __m256 offsetX = _mm256_set1_ps(offset.x);
+        const __m256 offsetZ = _mm256_set1_ps(offset.y);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 limitX = _mm256_set1_ps(maxX);
+        const __m256 limitZ = _mm256_set1_ps(maxZ);
+        const __m256 cellLimitX = _mm256_set1_ps(maxCellX);
+        const __m256 cellLimitZ = _mm256_set1_ps(maxCellZ);
+        const __m256i rowStride = _mm256_set1_epi32(width);
+        for (; i + 8 <= count; i += 8) {
+            // (x, z) pairs to x and z lanes, in order
+            __m256 first = _mm256_loadu_ps(coords + i * 2);
+            __m256 second = _mm256_loadu_ps(coords + i * 2 + 8);
+            __m256 xs = _mm256_castpd_ps(_mm256_permute4x64_pd(
+                _mm256_castps_pd(_mm256_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+            __m256 zs = _mm256_castpd_ps(_mm256_permute4x64_pd(
+                _mm256_castps_pd(_mm256_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+
+            __m256 gx = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(xs, scale), offsetX), zero), limitX);
+            __m256 gz = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(zs, scale), offsetZ), zero), limitZ);
+            __m256 cellX = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(gx)), cellLimitX);
+            __m256 cellZ = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(gz)), cellLimitZ);
+            __m256 fx = _mm256_sub_ps(gx, cellX);
+            __m256 fz = _mm256_sub_ps(gz, cellZ);
+
+            __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(cellZ), rowStride),
+                _mm256_cvttps_epi32(cellX));
+            __m256 h00 = _mm256_i32gather_ps(heights, index, 4);
+            __m256 h10 = _mm256_i32gather_ps(heights + 1, index, 4);
+            __m256 h01 = _mm256_i32gather_ps(heights + width, index, 4);
+            __m256 h11 = _mm256_i32gather_ps(heights + width + 1, index, 4);
+            _mm256_storeu_ps(out + i, lerp8(lerp8(h00, h10, fx), lerp8(h01, h11, fx), fz));
+        }
+    }
+#endif
+#if HEIGHT_SAMPLER_SSE2
+    {
+        const __m128 scale = _mm_set1_ps(invSpacing);
+        const __m128 offsetX = _mm_set1_ps(offset.x);
+        const __m128 offsetZ = _mm_set1_ps(offset.y);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 limitX = _mm_set1_ps(maxX);
+        const __m128 limitZ = _mm_set1_ps(maxZ);
+        const __m128 cellLimitX = _mm_set1_ps(maxCellX);
+        const __m128 cellLimitZ = _mm_set1_ps(maxCellZ);
+        alignas(16) int cellXs[4];
+        alignas(16) int cellZs[4];
+        alignas(16) float corners[4][4];
+        for (; i + 4 <= count; i += 4) {
+            __m128 first = _mm_loadu_ps(coords + i * 2);
+            __m128 second = _mm_loadu_ps(coords + i * 2 + 4);
+            __m128 xs = _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 zs = _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+
+            __m128 gx = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(xs, scale), offsetX), zero), limitX);
+            __m128 gz = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(zs, scale), offsetZ), zero), limitZ);
+            __m128 cellX = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gx)), cellLimitX);
+            __m128 cellZ = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gz)), cellLimitZ);
+            __m128 fx = _mm_sub_ps(gx, cellX);
+            __m128 fz = _mm_sub_ps(gz, cellZ);
+
+            // No gather before AVX2: fetch the four corners per lane
+            _mm_store_si128(reinterpret_cast<__m128i*>(cellXs), _mm_cvttps_epi32(cellX));
+            _mm_store_si128(reinterpret_cast<__m128i*>(cellZs), _mm_cvttps_epi32(cellZ));
+            for (int lane = 0; lane < 4; ++lane) {
+                const float* row0 = heights + static_cast<size_t>(cellZs[lane]) * width + cellXs[lane];
+                corners[0][lane] = row0[0];
+                corners[1][lane] = row0[1];
+                corners[2][lane] = row0[width];
+                corners[3][lane] = row0[width + 1];
+            }
+            __m128 top = lerp4(_mm_load_ps(corners[0]), _mm_load_ps(corners[1]), fx);
+            __m128 bottom = lerp4(_mm_load_ps(corners[2]), _mm_load_ps(corners[3]), fx);
+            _mm_storeu_ps(out + i, lerp4(top, bottom, fz));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        float gx = positions[i].x * invSpacing + offset.x;
+        float gz = positions[i].y * invSpacing + offset.y;
+        out[i] = bilinear(heights, width, maxX, maxZ, maxCellX, maxCellZ, gx, gz);
+    }
+}
@@ -0,0 +1,17 @@
+// height_sampler.h
+#pragma once
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Bilinear lookups in a regular height grid (row-major, at least 2x2).
+// Coordinates are in samples and clamped to the grid, so positions past
+// the edge get the border height.
+float sampleGridHeight(const float* heights, int width, int height, float gridX, float gridZ);
+
+// Batched sampleGridHeight for count positions mapped to grid coordinates
+// as position * invSpacing + offset. Runs 4 (SSE2) or 8 (AVX2) positions
+// per iteration with the same operation order as the scalar version, so
+// the results are bit-identical to it.
+void sampleGridHeights(const float* heights, int width, int height,
+    float invSpacing, const glm::vec2& offset,
+    const glm::vec2* positions, float* out, size_t count);
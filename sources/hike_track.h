@@ -0,0 +1,39 @@
+// hike_track.h
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Recorded track as one array per quantity (structure of arrays), so
+// analysis and GPU uploads read only the columns they use. All columns
+// have one entry per point; values a point was recorded without are NaN.
+struct HikeTrack {
+    // Position x = 0, z = 0 is at this longitude and latitude (degrees)
+    double originLongitude{ 0.0 };
+    double originLatitude{ 0.0 };
+
+    std::vector<glm::vec3> positions;   // Local: x east, y elevation, z north (see gpsToLocalCoordinates)
+    std::vector<double> times;          // Seconds since the Unix epoch
+    std::vector<float> heartRates;      // Beats per minute
+    std::vector<float> cadences;        // Steps (or revolutions) per minute
+    std::vector<float> temperatures;    // Air temperature, degrees Celsius
+
+    size_t size() const { return positions.size(); }
+    bool empty() const { return positions.empty(); }
+
+    void reserve(size_t count) {
+        positions.reserve(count);
+        times.reserve(count);
+        heartRates.reserve(count);
+        cadences.reserve(count);
+        temperatures.reserve(count);
+    }
+
+    void clear() {
+        positions.clear();
+        times.clear();
+        heartRates.clear();
+        cadences.clear();
+        temperatures.clear();
+    }
+};
@@ -1,104 +1,123 @@
 // hiking_data.cpp
 #include "hiking_data.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <limits>
-#include "tinyxml2.h"
-
-// Globals to store min values
-double minLon = std::numeric_limits<double>::max();
-double minLat = std::numeric_limits<double>::max();
+#include <cstdio>
+#include <sys/stat.h>
+#include <memory>
+#include <thread>
+#include "gpx_reader.h"
+#include "terrain_cache.h"
+#include "thread_pool.h"
+#include "track_file.h"
+
+namespace {
+    // File bytes per track point with the usual children and a Garmin
+    // extension block; only sizes the first allocation of the columns
+    constexpr size_t TYPICAL_POINT_BYTES = 256;
+}
 
-glm::vec3 gpsToLocalCoordinates(double lat, double lon, double ele) {
+glm::vec3 gpsToLocalCoordinates(const GpsProjection& projection, double lat, double lon, double ele) {
     // Adjust these scale factors to match your terrain scale
     const float TERRAIN_SCALE = 100000.0f; // Adjust as needed
     const float HEIGHT_SCALE = 1.0f;       // Adjust for elevation scaling
 
-    // Use minLon and minLat as origins
-    float x = static_cast<float>((lon - minLon) * TERRAIN_SCALE);
-    float z = static_cast<float>((lat - minLat) * TERRAIN_SCALE);
+    float x = static_cast<float>((lon - projection.originLongitude) * TERRAIN_SCALE);
+    float z = static_cast<float>((lat - projection.originLatitude) * TERRAIN_SCALE);
     float y = static_cast<float>(ele * HEIGHT_SCALE);
 
     return glm::vec3(x, y, z);
 }
 
 
-bool loadHikingData(const std::string& filename, std::vector<glm::vec3>& hikingPoints) {
+void reprojectHikeTrack(HikeTrack& track, const GpsProjection& projection) {
+    // Where the track's origin lies in the new projection
+    const glm::vec3 shift = gpsToLocalCoordinates(projection, track.originLatitude, track.originLongitude, 0.0);
+    if (shift.x != 0.0f || shift.z != 0.0f) {
+        for (auto& position : track.positions) {
+            position += shift;
+        }
+    }
+    track.originLongitude = projection.originLongitude;
+    track.originLatitude = projection.originLatitude;
+}
+
+bool loadHikeTrack(const std::string& filename, HikeTrack& track, const GpsProjection* projection) {
     try {
-        tinyxml2::XMLDocument doc;
-        if (doc.LoadFile(filename.c_str()) != tinyxml2::XML_SUCCESS) {
+        auto loadStart = std::chrono::steady_clock::now();
+        GpxReader reader;
+        if (!reader.open(filename)) {
             std::cerr << "Error loading GPX file: " << filename << std::endl;
             return false;
         }
 
-        // Get the root element (gpx)
-        tinyxml2::XMLElement* gpx = doc.FirstChildElement("gpx");
-        if (!gpx) {
-            std::cerr << "No GPX element found" << std::endl;
-            return false;
+        // Room for the points up front, so the columns rarely grow; the
+        // reader itself allocates nothing per point
+        track.clear();
+        track.reserve(reader.getFileSize() / TYPICAL_POINT_BYTES);
+
+        // One pass over the file. The track's own origin is its south-west
+        // corner, only known at the end, so positions are kept as (lon, ele,
+        // lat) offsets from the first point until then; small offsets keep
+        // their precision in floats.
+        const float missing = std::numeric_limits<float>::quiet_NaN();
+        double firstLat = 0.0;
+        double firstLon = 0.0;
+        GpxTrackPoint point;
+        while (reader.next(point)) {
+            if (track.empty()) {
+                firstLat = point.latitude;
+                firstLon = point.longitude;
+            }
+            track.positions.push_back(glm::vec3(static_cast<float>(point.longitude - firstLon),
+                static_cast<float>(point.elevation), static_cast<float>(point.latitude - firstLat)));
+            track.times.push_back(point.hasTime ? point.time : std::numeric_limits<double>::quiet_NaN());
+            track.heartRates.push_back(point.hasHeartRate ? point.heartRate : missing);
+            track.cadences.push_back(point.hasCadence ? point.cadence : missing);
+            track.temperatures.push_back(point.hasTemperature ? point.temperature : missing);
         }
-
-        // Get the track (trk)
-        tinyxml2::XMLElement* trk = gpx->FirstChildElement("trk");
-        if (!trk) {
-            std::cerr << "No track element found" << std::endl;
+        if (reader.failed()) {
             return false;
         }
 
-        // Get the track segment (trkseg)
-        tinyxml2::XMLElement* trkseg = trk->FirstChildElement("trkseg");
-        if (!trkseg) {
-            std::cerr << "No track segment found" << std::endl;
+        // Validate that we loaded some points
+        if (track.empty()) {
+            std::cerr << "No track points found in GPX file" << std::endl;
             return false;
         }
-
-        // First pass to find minLon and minLat
-        for (tinyxml2::XMLElement* trkpt = trkseg->FirstChildElement("trkpt");
-            trkpt != nullptr;
-            trkpt = trkpt->NextSiblingElement("trkpt")) {
-
-            double lat = trkpt->DoubleAttribute("lat");
-            double lon = trkpt->DoubleAttribute("lon");
-
-            if (lon < minLon) minLon = lon;
-            if (lat < minLat) minLat = lat;
+        if (reader.getSkippedPoints() > 0) {
+            std::cerr << "Skipped " << reader.getSkippedPoints() << " track point(s) without lat/lon" << std::endl;
         }
 
-        // Clear existing points
-        hikingPoints.clear();
-
-        // Second pass to process points
-        for (tinyxml2::XMLElement* trkpt = trkseg->FirstChildElement("trkpt");
-            trkpt != nullptr;
-            trkpt = trkpt->NextSiblingElement("trkpt")) {
-
-            double lat = trkpt->DoubleAttribute("lat");
-            double lon = trkpt->DoubleAttribute("lon");
-
-            // Get elevation
-            tinyxml2::XMLElement* ele = trkpt->FirstChildElement("ele");
-            double elevation = 0.0;
-            if (ele) {
-                elevation = std::stod(ele->GetText());
-            }
-
-            // Convert GPS coordinates to local coordinate system
-            glm::vec3 point = gpsToLocalCoordinates(lat, lon, elevation);
-            hikingPoints.push_back(point);
+        // Origin over the loaded points, then convert them in place
+        float minLonOffset = std::numeric_limits<float>::max();
+        float minLatOffset = std::numeric_limits<float>::max();
+        for (const auto& offset : track.positions) {
+            minLonOffset = std::min(minLonOffset, offset.x);
+            minLatOffset = std::min(minLatOffset, offset.z);
         }
-
-        // Validate that we loaded some points
-        if (hikingPoints.empty()) {
-            std::cerr << "No track points found in GPX file" << std::endl;
-            return false;
+        GpsProjection ownProjection;
+        ownProjection.originLongitude = firstLon + minLonOffset;
+        ownProjection.originLatitude = firstLat + minLatOffset;
+        const GpsProjection& target = projection ? *projection : ownProjection;
+        for (auto& offset : track.positions) {
+            offset = gpsToLocalCoordinates(target, firstLat + offset.z, firstLon + offset.x, offset.y);
         }
+        track.originLongitude = target.originLongitude;
+        track.originLatitude = target.originLatitude;
 
         // Optional: Print out some points for debugging
-        for (size_t i = 0; i < std::min<size_t>(5, hikingPoints.size()); ++i) {
-            std::cout << "Point " << i << ": (" << hikingPoints[i].x << ", "
-                << hikingPoints[i].y << ", " << hikingPoints[i].z << ")" << std::endl;
+        for (size_t i = 0; i < std::min<size_t>(5, track.size()); ++i) {
+            std::cout << "Point " << i << ": (" << track.positions[i].x << ", "
+                << track.positions[i].y << ", " << track.positions[i].z << ")" << std::endl;
         }
 
-        std::cout << "Successfully loaded " << hikingPoints.size() << " hiking points" << std::endl;
+        auto loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart);
+        std::cout << "Successfully loaded " << track.size() << " hiking points from "
+            << reader.getFileSize() / 1024 << " KB in " << loadTime.count() << " ms ("
+            << reader.getFileSize() / (1024.0 * 1024.0) / std::max(loadTime.count() / 1000.0, 1e-9) << " MB/s)" << std::endl;
         return true;
     }
     catch (const std::exception& e) {
@@ -106,3 +125,101 @@ bool loadHikingData(const std::string& filename, std::vector<glm::vec3>& hikingP
         return false;
     }
 }
+
+bool loadHikeTrackCached(const std::string& filename, const std::string& cacheDirectory, HikeTrack& track,
+    const GpsProjection* projection) {
+    struct stat status;
+    if (cacheDirectory.empty() || stat(filename.c_str(), &status) != 0) {
+        return loadHikeTrack(filename, track, projection);
+    }
+
+    // One cache file per GPX path; its key changes with the file's contents
+    const uint64_t pathHash = hashBytes(filename.data(), filename.size());
+    const int64_t stamp[] = { static_cast<int64_t>(status.st_size), static_cast<int64_t>(status.st_mtime) };
+    const uint64_t key = hashBytes(stamp, sizeof(stamp), pathHash);
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "track_%016llx.trk", static_cast<unsigned long long>(pathHash));
+    const std::string cachePath = cacheDirectory + "/" + fileName;
+
+    auto loadStart = std::chrono::steady_clock::now();
+    // The file holds the track relative to its own origin
+    TrackFile file;
+    if (!file.open(cachePath, key)) {
+        if (!loadHikeTrack(filename, track)) {
+            return false;
+        }
+        TrackFile::write(cachePath, key, track);
+        if (projection) {
+            reprojectHikeTrack(track, *projection);
+        }
+        return true;
+    }
+    file.copyTo(track);
+    if (projection) {
+        reprojectHikeTrack(track, *projection);
+    }
+
+    auto loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart);
+    std::cout << "Loaded " << track.size() << " hiking points from track cache " << cachePath << " in "
+        << loadTime.count() << " ms" << std::endl;
+    return true;
+}
+
+bool loadHikeTracks(const std::vector<std::string>& filenames, const std::string& cacheDirectory,
+    HikeTrackBatch& batch, ThreadPool* pool) {
+    auto loadStart = std::chrono::steady_clock::now();
+    const int count = static_cast<int>(filenames.size());
+    batch.tracks.clear();
+    batch.tracks.resize(filenames.size());
+
+    // Parsing is CPU bound: one worker per file, up to the hardware threads
+    std::unique_ptr<ThreadPool> ownPool;
+    if (!pool && count > 1) {
+        ownPool = std::make_unique<ThreadPool>(static_cast<unsigned int>(
+            std::min(count, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))));
+        pool = ownPool.get();
+    }
+    auto loadRange = [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            if (!loadHikeTrackCached(filenames[i], cacheDirectory, batch.tracks[i])) {
+                std::cerr << "Failed to load track " << filenames[i] << std::endl;
+                batch.tracks[i].clear();
+            }
+        }
+    };
+    if (pool) {
+        pool->parallelFor(0, count, loadRange);
+    }
+    else {
+        loadRange(0, count);
+    }
+
+    // Scene origin: the south-west corner of every loaded track
+    batch.sceneProjection.originLongitude = std::numeric_limits<double>::max();
+    batch.sceneProjection.originLatitude = std::numeric_limits<double>::max();
+    size_t loaded = 0;
+    for (const auto& track : batch.tracks) {
+        if (track.empty()) continue;
+        batch.sceneProjection.originLongitude = std::min(batch.sceneProjection.originLongitude, track.originLongitude);
+        batch.sceneProjection.originLatitude = std::min(batch.sceneProjection.originLatitude, track.originLatitude);
+        ++loaded;
+    }
+    if (loaded == 0) {
+        batch.sceneProjection = GpsProjection();
+        return false;
+    }
+
+    auto loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart);
+    std::cout << "Loaded " << loaded << " of " << count << " tracks in " << loadTime.count() << " ms on "
+        << (pool ? pool->size() : 1u) << " thread(s)" << std::endl;
+    return true;
+}
+
+bool loadHikingData(const std::string& filename, std::vector<glm::vec3>& hikingPoints) {
+    HikeTrack track;
+    if (!loadHikeTrack(filename, track)) {
+        return false;
+    }
+    hikingPoints.swap(track.positions);
+    return true;
+}
@@ -3,15 +3,50 @@
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
+#include "hike_track.h"
 
-struct HikingPoint {
-    glm::vec3 position{ 0.0f };
-    float timestamp{ 0.0f };
+class ThreadPool;
+
+// Origin of the local frame GPS positions are projected to (see
+// gpsToLocalCoordinates). Every load takes its own or an explicit one, so
+// loads are independent of each other and may run on several threads.
+struct GpsProjection {
+    double originLongitude{ 0.0 };
+    double originLatitude{ 0.0 };
+};
+
+// Tracks loaded together by loadHikeTracks
+struct HikeTrackBatch {
+    std::vector<HikeTrack> tracks;      // Per file, in order, each relative to its own origin; empty if it failed
+    GpsProjection sceneProjection;      // South-west corner of all of them; see reprojectHikeTrack
 };
 
+// Every track point of a GPX file with its time, heart rate, cadence and
+// temperature where recorded. Positions are relative to projection if
+// given, otherwise to the track's own south-west corner; the track keeps
+// the origin used.
+bool loadHikeTrack(const std::string& filename, HikeTrack& track, const GpsProjection* projection = nullptr);
+
+// loadHikeTrack through a binary TrackFile in cacheDirectory, written on
+// the first load and used while the GPX file keeps its size and
+// modification time. An empty cacheDirectory always parses the GPX.
+bool loadHikeTrackCached(const std::string& filename, const std::string& cacheDirectory, HikeTrack& track,
+    const GpsProjection* projection = nullptr);
+
+// Loads the files in parallel, on pool's workers or on a pool of its own,
+// each with its own origin, and finds the origin shared by all of them.
+// false if none of them loaded.
+bool loadHikeTracks(const std::vector<std::string>& filenames, const std::string& cacheDirectory,
+    HikeTrackBatch& batch, ThreadPool* pool = nullptr);
+
+// Moves a track's positions to another origin
+void reprojectHikeTrack(HikeTrack& track, const GpsProjection& projection);
+
+// Just the positions of loadHikeTrack
 bool loadHikingData(const std::string& filename, std::vector<glm::vec3>& hikingPoints);
 void smoothPath(std::vector<glm::vec3>& points);
-glm::vec3 gpsToLocalCoordinates(double lat, double lon, double ele);
+// x east and z north of the projection's origin, y the elevation
+glm::vec3 gpsToLocalCoordinates(const GpsProjection& projection, double lat, double lon, double ele);
 
 // Constants for coordinate transformation
 //constexpr double SCALE_FACTOR = 100.0;
@@ -20,12 +20,16 @@ void HikingVisualizer::cleanup() {
 }
 
 bool HikingVisualizer::initialize(const std::vector<glm::vec3>& hikingPoints) {
-    if (hikingPoints.empty()) {
+    return initialize(hikingPoints.data(), hikingPoints.size());
+}
+
+bool HikingVisualizer::initialize(const glm::vec3* hikingPoints, size_t count) {
+    if (count == 0) {
         std::cerr << "No hiking points provided" << std::endl;
         return false;
     }
 
-    trailPoints = hikingPoints;
+    trailPoints.assign(hikingPoints, hikingPoints + count);
     currentPosition = trailPoints[0];
 
     // Load shaders using the Shader class
@@ -12,6 +12,8 @@ public:
     ~HikingVisualizer();
 
     bool initialize(const std::vector<glm::vec3>& hikingPoints);
+    // From any contiguous positions, such as a TrackFile column
+    bool initialize(const glm::vec3* hikingPoints, size_t count);
     void update(float deltaTime);
     void draw(const glm::mat4& view, const glm::mat4& projection);
     void cleanup();
@@ -31,6 +33,7 @@ public:
     glm::vec3 getCurrentHikerPosition() const { return currentPosition; }
     void setHikerSpeed(float speed) { hikerSpeed = speed; }
     float getHikerSpeed() const { return hikerSpeed; }
+    size_t getGpuBytes() const { return (trailPoints.size() + 1) * sizeof(glm::vec3); }
 
 private:
     bool setupTrailBuffer();
@@ -0,0 +1,82 @@
+// image_loader.cpp
+#include "image_loader.h"
+#include <algorithm>
+#include <chrono>
+#include "../external/stb_image.h"
+
+ImageLoader::ImageLoader(unsigned int threadCount) : pool(threadCount) {
+}
+
+size_t ImageLoader::request(const std::string& path, int channels) {
+    DecodedImage image;
+    image.path = path;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        image.id = requested++;
+    }
+    size_t id = image.id;
+    pool.submit([this, image, channels]() { decode(image, channels); });
+    return id;
+}
+
+void ImageLoader::decode(DecodedImage image, int channels) {
+    // stb_image keeps its failure reason per thread, so workers don't
+    // overwrite each other's errors
+    auto decodeStart = std::chrono::steady_clock::now();
+    int width, height, fileChannels;
+    if (channels == 0 && stbi_info(image.path.c_str(), &width, &height, &fileChannels)) {
+        channels = fileChannels < 3 ? fileChannels + 2 : fileChannels;
+    }
+    unsigned char* data = stbi_load(image.path.c_str(), &width, &height, &fileChannels, channels);
+    if (data) {
+        image.width = width;
+        image.height = height;
+        image.channels = channels ? channels : fileChannels;
+        image.pixels = std::shared_ptr<unsigned char>(data, [](unsigned char* pixels) { stbi_image_free(pixels); });
+    }
+    else {
+        image.error = stbi_failure_reason();
+    }
+    image.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        finished.push(std::move(image));
+    }
+    finishedCondition.notify_all();
+}
+
+bool ImageLoader::tryNext(DecodedImage& image) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (finished.empty()) return false;
+    image = std::move(finished.front());
+    finished.pop();
+    ++delivered;
+    return true;
+}
+
+bool ImageLoader::next(DecodedImage& image) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if (delivered == requested) return false;
+    finishedCondition.wait(lock, [this]() { return !finished.empty(); });
+    image = std::move(finished.front());
+    finished.pop();
+    ++delivered;
+    return true;
+}
+
+std::vector<DecodedImage> ImageLoader::waitAll() {
+    std::vector<DecodedImage> images;
+    DecodedImage image;
+    while (next(image)) {
+        images.push_back(std::move(image));
+    }
+    std::sort(images.begin(), images.end(),
+        [](const DecodedImage& a, const DecodedImage& b) { return a.id < b.id; });
+    return images;
+}
+
+size_t ImageLoader::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return requested - delivered;
+}
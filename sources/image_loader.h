@@ -0,0 +1,69 @@
+// image_loader.h
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+// One decoded image; pixels are row-major, top row first, channels bytes
+// per texel, and stay valid as long as a copy of the pointer does
+struct DecodedImage {
+    size_t id{ 0 };                         // Order of the request, from 0
+    std::string path;
+    int width{ 0 };
+    int height{ 0 };
+    int channels{ 0 };
+    std::shared_ptr<unsigned char> pixels;  // Null if decoding failed
+    std::string error;                      // Why, when it failed
+    double decodeMs{ 0.0 };
+
+    size_t getBytes() const { return static_cast<size_t>(width) * height * channels; }
+};
+
+// Decodes image files on a pool of worker threads, all requests at once,
+// and hands the results to the consuming thread (usually the GL thread)
+// through a queue in the order they finish. A batch of images then takes
+// about as long as its slowest decode instead of the sum of them all.
+class ImageLoader {
+public:
+    // threadCount == 0 uses one worker per hardware thread
+    explicit ImageLoader(unsigned int threadCount = 0);
+
+    // Delete copy constructor and assignment operator
+    ImageLoader(const ImageLoader&) = delete;
+    ImageLoader& operator=(const ImageLoader&) = delete;
+
+    // Starts decoding path and returns its id. channels is forced like
+    // stbi_load's desired channels; 0 keeps the file's own count but widens
+    // grey and grey-alpha to RGB and RGBA, so colour textures always come
+    // as 3 or 4 channels.
+    size_t request(const std::string& path, int channels = 0);
+
+    // Next finished image, without waiting; false if none is ready
+    bool tryNext(DecodedImage& image);
+
+    // Next finished image, waiting for one if needed; false once every
+    // requested image has been handed out
+    bool next(DecodedImage& image);
+
+    // Every image not handed out yet, in request order
+    std::vector<DecodedImage> waitAll();
+
+    size_t getPendingCount() const;
+
+private:
+    mutable std::mutex queueMutex;
+    std::condition_variable finishedCondition;
+    std::queue<DecodedImage> finished;
+    size_t requested{ 0 };
+    size_t delivered{ 0 };
+
+    // Last, so the workers are joined before the queue goes away
+    ThreadPool pool;
+
+    void decode(DecodedImage image, int channels);
+};
@@ -13,21 +13,38 @@
 #include "math_utils.h"
 #include "hiking_data.h"
 #include "skybox.h"
+#include "area_cache.h"
+#include "text_parse.h"
 
 // Global variables
 Camera camera(glm::vec3(0.0f, 500.0f, 500.0f));
-HikingVisualizer hikingVisualizer;
+HikingVisualizer* hikingVisualizer = nullptr;
 float lastX = 640.0f;
 float lastY = 360.0f;
 bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 bool followHiker = false;
+bool areaSwitchRequested = false;
 
 // Window dimensions
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
 
+// Time per frame a background terrain load may spend uploading to the GPU
+const double TERRAIN_UPLOAD_BUDGET_MS = 4.0;
+
+// Video memory for areas kept resident after switching away from them
+const size_t AREA_CACHE_BUDGET_MB = 1024;
+
+// Analytic sky instead of the textured cubemap, lit by the same sun as the
+// terrain (the opposite of lightDir in fragment_shader.glsl)
+const bool USE_ANALYTIC_SKY = true;
+const glm::vec3 SUN_DIRECTION(0.2f, 1.0f, 0.3f);
+
+// Print the GPX number and time parsing throughput at startup
+const bool RUN_PARSE_BENCHMARK = false;
+
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
     float xpos = static_cast<float>(xposIn);
     float ypos = static_cast<float>(yposIn);
@@ -76,9 +93,9 @@ void processInput(GLFWwindow* window) {
 
     // Hiker speed control
     if (glfwGetKey(window, GLFW_KEY_KP_ADD) == GLFW_PRESS)
-        hikingVisualizer.setHikerSpeed(hikingVisualizer.getHikeStats().currentSpeed * 1.1f);
+        hikingVisualizer->setHikerSpeed(hikingVisualizer->getHikeStats().currentSpeed * 1.1f);
     if (glfwGetKey(window, GLFW_KEY_KP_SUBTRACT) == GLFW_PRESS)
-        hikingVisualizer.setHikerSpeed(hikingVisualizer.getHikeStats().currentSpeed * 0.9f);
+        hikingVisualizer->setHikerSpeed(hikingVisualizer->getHikeStats().currentSpeed * 0.9f);
 
     // Reset camera
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
@@ -113,9 +130,29 @@ void processInput(GLFWwindow* window) {
     else {
         fPressed = false;
     }
+
+    // Switch to the next area, loading it in the background if needed
+    static bool tPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
+        if (!tPressed) {
+            areaSwitchRequested = true;
+            tPressed = true;
+        }
+    }
+    else {
+        tPressed = false;
+    }
 }
 
 int main() {
+    if (RUN_PARSE_BENCHMARK) {
+        TextParseBenchmark benchmark = benchmarkTextParsing(1000000);
+        std::cout << "Parsing " << benchmark.values << " values: decimals " << benchmark.decimalMBps
+            << " MB/s (strtod " << benchmark.referenceDecimalMBps << " MB/s), ISO 8601 times "
+            << benchmark.timeMBps << " MB/s (sscanf " << benchmark.referenceTimeMBps << " MB/s), "
+            << benchmark.mismatches << " mismatch(es)" << std::endl;
+    }
+
     // Initialize window
     Window window(SCR_WIDTH, SCR_HEIGHT, "OpenGL Hiking Simulator");
     if (!window.initialize()) {
@@ -152,43 +189,68 @@ int main() {
     };
 
     Skybox skybox;
-    if (!skybox.initialize(faces)) {
+    bool skyReady = USE_ANALYTIC_SKY ? skybox.initializeAnalytic(SUN_DIRECTION) : skybox.initialize(faces);
+    if (!skyReady) {
         std::cerr << "Failed to initialize skybox" << std::endl;
         return -1;
     }
 
-    // Load hiking data
-    std::vector<glm::vec3> hikingData;
-    if (!loadHikingData("A:/Taief/Project/OpenGL_Project/data/Afternoon_Run.gpx", hikingData)) {
-        std::cerr << "Failed to load hiking data" << std::endl;
-        return -1;
+    // The areas T cycles through. The same region in each GPU render mode
+    // for now; Streaming needs a height pyramid rather than the height map.
+    AreaDescription baseArea;
+    baseArea.heightMapPath = "A:/Taief/Project/OpenGL_Project/data/hoydedata_svarthvitt.png";
+    baseArea.texturePath = "A:/Taief/Project/OpenGL_Project/textures/tex2.png";
+    baseArea.gpxPath = "A:/Taief/Project/OpenGL_Project/data/Afternoon_Run.gpx";
+
+    // Grass low down, the lighter textures further up and rock on the
+    // steepest slopes, which stay below about 11 degrees on this map
+    auto material = [](const char* texture, float minHeight, float maxHeight, float minSlope, float maxSlope) {
+        TerrainMaterial layer;
+        layer.texturePath = std::string("A:/Taief/Project/OpenGL_Project/textures/") + texture;
+        layer.minHeight = minHeight;
+        layer.maxHeight = maxHeight;
+        layer.minSlope = minSlope;
+        layer.maxSlope = maxSlope;
+        return layer;
+    };
+    baseArea.settings.materials = {
+        material("grass.png", 0.0f, 0.4f, 0.0f, 4.0f),
+        material("tex2.png", 0.35f, 0.7f, 0.0f, 5.0f),
+        material("tex(1).png", 0.65f, 0.85f, 0.0f, 6.0f),
+        material("tex(6).png", 0.8f, 1.0f, 0.0f, 6.0f),
+        material("rock.png", 0.0f, 1.0f, 4.0f, 90.0f)
+    };
+    std::vector<AreaDescription> areas;
+    const std::pair<const char*, TerrainRenderMode> areaModes[] = {
+        { "svarthvitt/mesh", TerrainRenderMode::Mesh },
+        { "svarthvitt/gpu", TerrainRenderMode::GpuDisplaced },
+        { "svarthvitt/cdlod", TerrainRenderMode::Cdlod }
+    };
+    for (const auto& mode : areaModes) {
+        AreaDescription area = baseArea;
+        area.name = mode.first;
+        area.settings.renderMode = mode.second;
+        areas.push_back(area);
     }
-    std::cout << "Loaded " << hikingData.size() << " hiking points" << std::endl;
 
-    // Initialize hiking visualizer
-    if (!hikingVisualizer.initialize(hikingData)) {
-        std::cerr << "Failed to initialize hiking visualizer" << std::endl;
+    // Load the first area: terrain, hiking data and trail
+    AreaCache areaCache(AREA_CACHE_BUDGET_MB * 1024 * 1024);
+    size_t currentArea = 0;
+    size_t requestedArea = 0;
+    Area* area = areaCache.load(areas[currentArea]);
+    if (!area) {
+        std::cerr << "Failed to load area " << areas[currentArea].name << std::endl;
         return -1;
     }
+    hikingVisualizer = area->visualizer.get();
+    std::cout << "Loaded " << area->hikingData.size() << " hiking points" << std::endl;
 
     // Set camera position near the first point of the trail
-    if (!hikingData.empty()) {
-        glm::vec3 firstPoint = hikingData.front();
+    if (!area->hikingData.empty()) {
+        glm::vec3 firstPoint = area->hikingData.front();
         camera.setPosition(firstPoint + glm::vec3(0.0f, 50.0f, 150.0f)); // Adjust offsets as needed
     }
 
-
-
-    // Initialize terrain
-    Terrain terrain;
-    if (!terrain.initialize(
-        "A:/Taief/Project/OpenGL_Project/data/hoydedata_svarthvitt.png",
-        "A:/Taief/Project/OpenGL_Project/textures/tex2.png",
-        hikingData)) {
-        std::cerr << "Failed to initialize terrain" << std::endl;
-        return -1;
-    }
-
     // Load shaders
     GLuint terrainShader = loadShaders(
         "A:/Taief/Project/OpenGL_Project/shaders/vertex_shader.glsl",
@@ -215,22 +277,36 @@ int main() {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Update hiking visualization
-        hikingVisualizer.update(deltaTime);
+        hikingVisualizer->update(deltaTime);
 
         // Update camera if following hiker
         if (followHiker) {
-            glm::vec3 hikerPos = hikingVisualizer.getCurrentHikerPosition();
+            glm::vec3 hikerPos = hikingVisualizer->getCurrentHikerPosition();
             camera.setPosition(hikerPos + glm::vec3(-150.0f, 100.0f, -150.0f));
         }
 
+        // The current area is drawn until the requested one is resident
+        if (areaSwitchRequested) {
+            requestedArea = (requestedArea + 1) % areas.size();
+        }
+        areaSwitchRequested = false;
+        areaCache.update(TERRAIN_UPLOAD_BUDGET_MS);
+        if (requestedArea != currentArea) {
+            if (Area* next = areaCache.acquire(areas[requestedArea])) {
+                area = next;
+                currentArea = requestedArea;
+                hikingVisualizer = area->visualizer.get();
+            }
+        }
+
         // Get view matrix
         glm::mat4 view = camera.getViewMatrix();
 
         // Draw terrain
-        terrain.draw(view, projection);
+        area->terrain->draw(view, projection);
 
         // Draw hiking trail
-        hikingVisualizer.draw(view, projection);
+        hikingVisualizer->draw(view, projection);
 
         // Draw skybox last
         glDepthFunc(GL_LEQUAL);  // Change depth function for skybox
@@ -238,10 +314,14 @@ int main() {
         glDepthFunc(GL_LESS);    // Restore default depth function
 
         // Display stats
-        auto stats = hikingVisualizer.getHikeStats();
+        auto stats = hikingVisualizer->getHikeStats();
         std::cout << "\rElevation: " << stats.currentElevation
             << "m | Completion: " << stats.completionPercentage
-            << "% | Speed: " << stats.currentSpeed << " m/s" << std::flush;
+            << "% | Speed: " << stats.currentSpeed << " m/s"
+            << " | Chunks: " << area->terrain->getVisibleChunkCount() << "/" << area->terrain->getTotalChunkCount()
+            << " | Areas: " << areaCache.getStats().hits << " hits, " << areaCache.getStats().misses << " misses, "
+            << areaCache.getStats().residentBytes / (1024 * 1024) << " MB"
+            << std::flush;
 
         glfwSwapBuffers(window.getGLFWwindow());
         glfwPollEvents();
@@ -97,6 +97,14 @@ public:
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
     }
 
+    void setVec2(const std::string& name, const glm::vec2& value) const {
+        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    }
+
+    void setVec2Array(const std::string& name, const glm::vec2* values, int count) const {
+        glUniform2fv(glGetUniformLocation(ID, (name + "[0]").c_str()), count, &values[0][0]);
+    }
+
     void setVec3(const std::string& name, const glm::vec3& value) const {
         glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
     }
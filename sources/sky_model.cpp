@@ -0,0 +1,90 @@
+// sky_model.cpp
+#include "sky_model.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Scale from luminance relative to the zenith to the exposure curve;
+    // the zenith ends up at about 0.4 of the display range
+    constexpr float ZENITH_EXPOSURE = 0.5f;
+
+    // Darkest the sky gets below the horizon, relative to the horizon colour
+    constexpr float GROUND_DARKENING = 0.35f;
+
+    // Elevation over which the sky fades to the ground below the horizon
+    constexpr float GROUND_FADE = 0.1f;
+
+    inline float toSrgb(float linear) {
+        linear = std::min(std::max(linear, 0.0f), 1.0f);
+        return linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+    }
+}
+
+float PreethamSky::Perez::operator()(float cosTheta, float gamma, float cosGamma) const {
+    return (1.0f + a * std::exp(b / cosTheta)) * (1.0f + c * std::exp(d * gamma) + e * cosGamma * cosGamma);
+}
+
+PreethamSky::PreethamSky(const glm::vec3& sunDirection, float turbidity) {
+    const float t = turbidity;
+    sun = glm::normalize(sunDirection);
+
+    // The model is only defined for a sun above the horizon
+    const float thetaS = std::acos(std::min(std::max(sun.y, 0.001f), 1.0f));
+
+    perezY = { 0.1787f * t - 1.4630f, -0.3554f * t + 0.4275f, -0.0227f * t + 5.3251f, 0.1206f * t - 2.5771f, -0.0670f * t + 0.3703f };
+    perezX = { -0.0193f * t - 0.2592f, -0.0665f * t + 0.0008f, -0.0004f * t + 0.2125f, -0.0641f * t - 0.8989f, -0.0033f * t + 0.0452f };
+    perezYChroma = { -0.0167f * t - 0.2608f, -0.0950f * t + 0.0092f, -0.0079f * t + 0.2102f, -0.0441f * t - 1.6537f, -0.0109f * t + 0.0529f };
+
+    const float chi = (4.0f / 9.0f - t / 120.0f) * (3.14159265f - 2.0f * thetaS);
+    const float zenithLuminance = (4.0453f * t - 4.9710f) * std::tan(chi) - 0.2155f * t + 2.4192f;
+    const float theta2 = thetaS * thetaS;
+    const float theta3 = theta2 * thetaS;
+    const float t2 = t * t;
+    const float zenithX =
+        (0.00166f * theta3 - 0.00375f * theta2 + 0.00209f * thetaS) * t2 +
+        (-0.02903f * theta3 + 0.06377f * theta2 - 0.03202f * thetaS + 0.00394f) * t +
+        (0.11693f * theta3 - 0.21196f * theta2 + 0.06052f * thetaS + 0.25886f);
+    const float zenithY =
+        (0.00275f * theta3 - 0.00610f * theta2 + 0.00317f * thetaS) * t2 +
+        (-0.04214f * theta3 + 0.08970f * theta2 - 0.04153f * thetaS + 0.00516f) * t +
+        (0.15346f * theta3 - 0.26756f * theta2 + 0.06670f * thetaS + 0.26688f);
+    zenith = glm::vec3(std::max(zenithLuminance, 0.0f), zenithX, zenithY);
+
+    // F(0, thetaS): straight up, thetaS away from the sun
+    const float cosThetaS = std::cos(thetaS);
+    zenithScale = glm::vec3(zenith.x / perezY(1.0f, thetaS, cosThetaS),
+        zenith.y / perezX(1.0f, thetaS, cosThetaS),
+        zenith.z / perezYChroma(1.0f, thetaS, cosThetaS));
+
+    // The exposure follows the zenith, so dusk is as readable as noon
+    exposure = ZENITH_EXPOSURE / std::max(zenith.x, 0.05f);
+}
+
+glm::vec3 PreethamSky::color(const glm::vec3& direction) const {
+    glm::vec3 view = glm::normalize(direction);
+
+    // Evaluated at the horizon at most; the ground is a darker horizon
+    float elevation = view.y;
+    float cosTheta = std::max(elevation, 0.01f);
+    glm::vec3 skyView = glm::normalize(glm::vec3(view.x, cosTheta, view.z));
+    float cosGamma = std::min(std::max(glm::dot(skyView, sun), -1.0f), 1.0f);
+    float gamma = std::acos(cosGamma);
+
+    float luminance = zenithScale.x * perezY(cosTheta, gamma, cosGamma);
+    float x = zenithScale.y * perezX(cosTheta, gamma, cosGamma);
+    float y = zenithScale.z * perezYChroma(cosTheta, gamma, cosGamma);
+
+    // Yxy to XYZ to linear sRGB, with a soft shoulder for the bright sun side
+    float exposed = 1.0f - std::exp(-luminance * exposure);
+    float X = x / y * exposed;
+    float Z = (1.0f - x - y) / y * exposed;
+    glm::vec3 rgb(3.2406f * X - 1.5372f * exposed - 0.4986f * Z,
+        -0.9689f * X + 1.8758f * exposed + 0.0415f * Z,
+        0.0557f * X - 0.2040f * exposed + 1.0570f * Z);
+
+    if (elevation < 0.0f) {
+        float fade = std::min(-elevation / GROUND_FADE, 1.0f);
+        rgb *= 1.0f - (1.0f - GROUND_DARKENING) * fade;
+    }
+    return glm::vec3(toSrgb(rgb.x), toSrgb(rgb.y), toSrgb(rgb.z));
+}
@@ -0,0 +1,29 @@
+// sky_model.h
+#pragma once
+#include <glm/glm.hpp>
+
+// Preetham, Shirley and Smits, "A Practical Analytic Model for Daylight"
+// (SIGGRAPH 1999): sky colour from the sun direction and the turbidity of
+// the air (2 = very clear, 6 = hazy). Directions are y-up. Below the
+// horizon the horizon colour fades to a dark ground colour.
+class PreethamSky {
+public:
+    PreethamSky(const glm::vec3& sunDirection, float turbidity);
+
+    // Display-ready sRGB colour in [0, 1] seen along direction
+    glm::vec3 color(const glm::vec3& direction) const;
+
+private:
+    struct Perez {
+        float a, b, c, d, e;
+        float operator()(float cosTheta, float gamma, float cosGamma) const;
+    };
+
+    glm::vec3 sun;
+    Perez perezY;
+    Perez perezX;
+    Perez perezYChroma;
+    glm::vec3 zenith;           // (Y, x, y) straight up
+    glm::vec3 zenithScale;      // zenith / F(0, sun zenith angle), per channel
+    float exposure{ 1.0f };
+};
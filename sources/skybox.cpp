@@ -1,7 +1,32 @@
 #include "skybox.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
-#include "../external/stb_image.h"
+#include "image_loader.h"
+#include "sky_model.h"
+
+namespace {
+    // Texels per side of an analytic sky face; the sky has no detail that
+    // needs more, and 6 x 64^2 RGB texels are 72 KB
+    constexpr int ANALYTIC_FACE_SIZE = 64;
+
+    // Sun movements below this (cosine of about 0.1 degrees) keep the sky
+    constexpr float SUN_CHANGE_COS = 0.9999985f;
+
+    // Direction through texel (s, t) in [-1, 1] of a cubemap face, following
+    // the GL face orientation table
+    glm::vec3 cubemapDirection(int face, float s, float t) {
+        switch (face) {
+        case 0: return glm::vec3(1.0f, -t, -s);
+        case 1: return glm::vec3(-1.0f, -t, s);
+        case 2: return glm::vec3(s, 1.0f, t);
+        case 3: return glm::vec3(s, -1.0f, -t);
+        case 4: return glm::vec3(s, -t, 1.0f);
+        default: return glm::vec3(-s, -t, -1.0f);
+        }
+    }
+}
 
 Skybox::Skybox() : skyboxShader(std::make_unique<Shader>()) {
 }
@@ -14,9 +39,77 @@ void Skybox::cleanup() {
     if (skyboxVAO) glDeleteVertexArrays(1, &skyboxVAO);
     if (skyboxVBO) glDeleteBuffers(1, &skyboxVBO);
     if (cubemapTexture) glDeleteTextures(1, &cubemapTexture);
+    skyboxVAO = skyboxVBO = cubemapTexture = 0;
 }
 
 bool Skybox::initialize(const std::vector<std::string>& faces) {
+    analytic = false;
+    return setupGeometry() && loadCubemap(faces);
+}
+
+bool Skybox::initializeAnalytic(const glm::vec3& sun, float skyTurbidity) {
+    if (!setupGeometry()) {
+        return false;
+    }
+    analytic = true;
+    sunDirection = glm::normalize(sun);
+    turbidity = skyTurbidity;
+
+    glGenTextures(1, &cubemapTexture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    for (int face = 0; face < 6; ++face) {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB8, ANALYTIC_FACE_SIZE, ANALYTIC_FACE_SIZE, 0,
+            GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    renderAnalyticSky();
+    return true;
+}
+
+void Skybox::setSunDirection(const glm::vec3& direction) {
+    glm::vec3 sun = glm::normalize(direction);
+    if (glm::dot(sun, sunDirection) >= SUN_CHANGE_COS) return;
+    sunDirection = sun;
+    if (analytic) {
+        renderAnalyticSky();
+    }
+}
+
+void Skybox::renderAnalyticSky() {
+    auto renderStart = std::chrono::steady_clock::now();
+    PreethamSky sky(sunDirection, turbidity);
+    std::vector<unsigned char> texels(static_cast<size_t>(ANALYTIC_FACE_SIZE) * ANALYTIC_FACE_SIZE * 3);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int face = 0; face < 6; ++face) {
+        unsigned char* texel = texels.data();
+        for (int y = 0; y < ANALYTIC_FACE_SIZE; ++y) {
+            float t = (y + 0.5f) * 2.0f / ANALYTIC_FACE_SIZE - 1.0f;
+            for (int x = 0; x < ANALYTIC_FACE_SIZE; ++x) {
+                float s = (x + 0.5f) * 2.0f / ANALYTIC_FACE_SIZE - 1.0f;
+                glm::vec3 color = sky.color(cubemapDirection(face, s, t));
+                *texel++ = static_cast<unsigned char>(color.x * 255.0f + 0.5f);
+                *texel++ = static_cast<unsigned char>(color.y * 255.0f + 0.5f);
+                *texel++ = static_cast<unsigned char>(color.z * 255.0f + 0.5f);
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0, ANALYTIC_FACE_SIZE, ANALYTIC_FACE_SIZE,
+            GL_RGB, GL_UNSIGNED_BYTE, texels.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    auto renderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart);
+    std::cout << "Analytic sky rendered in " << renderTime.count() << " ms ("
+        << texels.size() * 6 / 1024 << " KB)" << std::endl;
+}
+
+bool Skybox::setupGeometry() {
     float skyboxVertices[] = {
         // positions          
         // Back face
@@ -79,27 +172,39 @@ bool Skybox::initialize(const std::vector<std::string>& faces) {
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-    return loadCubemap(faces);
+    return true;
 }
 
 bool Skybox::loadCubemap(const std::vector<std::string>& faces) {
+    // All faces decode at once, one worker each; every face is uploaded as
+    // soon as it is done while the others are still decoding
+    auto loadStart = std::chrono::steady_clock::now();
+    ImageLoader decoder(static_cast<unsigned int>(faces.size()));
+    for (const auto& face : faces) {
+        decoder.request(face);
+    }
+
     glGenTextures(1, &cubemapTexture);
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    double slowestDecodeMs = 0.0;
+    DecodedImage image;
+    while (decoder.next(image)) {
+        if (!image.pixels) {
+            std::cout << "Cubemap texture failed to load at path: " << image.path << " (" << image.error << ")" << std::endl;
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
             return false;
         }
+        GLenum format = image.channels == 4 ? GL_RGBA : GL_RGB;
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(image.id),
+            0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+        slowestDecodeMs = std::max(slowestDecodeMs, image.decodeMs);
     }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    auto loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart);
+    std::cout << "Cubemap of " << faces.size() << " faces loaded in " << loadTime.count()
+        << " ms (slowest decode " << slowestDecodeMs << " ms)" << std::endl;
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -119,6 +224,9 @@ void Skybox::draw(const glm::mat4& view, const glm::mat4& projection) {
 
     skyboxShader->setMat4("view", skyView);
     skyboxShader->setMat4("projection", projection);
+    skyboxShader->setInt("skybox", 0);
+    skyboxShader->setBool("sunEnabled", analytic);
+    skyboxShader->setVec3("sunDirection", sunDirection);
 
     glBindVertexArray(skyboxVAO);
     glActiveTexture(GL_TEXTURE0);
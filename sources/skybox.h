@@ -15,7 +15,15 @@ public:
     Skybox(const Skybox&) = delete;
     Skybox& operator=(const Skybox&) = delete;
 
+    // Textured sky from six cubemap faces (+X, -X, +Y, -Y, +Z, -Z)
     bool initialize(const std::vector<std::string>& faces);
+
+    // Analytic sky (see PreethamSky) rendered into a small cubemap, which
+    // is only re-rendered when setSunDirection moves the sun. The sun
+    // direction points towards the sun, y up.
+    bool initializeAnalytic(const glm::vec3& sunDirection, float turbidity = 2.5f);
+    void setSunDirection(const glm::vec3& direction);
+
     void draw(const glm::mat4& view, const glm::mat4& projection);
     void cleanup();
 
@@ -25,5 +33,11 @@ private:
     GLuint cubemapTexture{ 0 };
     std::unique_ptr<Shader> skyboxShader;
 
+    bool analytic{ false };
+    glm::vec3 sunDirection{ 0.0f, 1.0f, 0.0f };
+    float turbidity{ 2.5f };
+
+    bool setupGeometry();
     bool loadCubemap(const std::vector<std::string>& faces);
+    void renderAnalyticSky();
 };
\ No newline at end of file
@@ -2,11 +2,97 @@
 #include <iostream>
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include "trail_index.h"
+#include "thread_pool.h"
+#include "grid_normals.h"
+#include "frustum.h"
+#include "vertex_cache.h"
+#include "terrain_rtin.h"
+#include "terrain_cache.h"
+#include "mapped_file.h"
+#include "height_pyramid.h"
+#include "height_sampler.h"
+#include "terrain_occlusion.h"
+#include "image_loader.h"
 #include "../external/stb_image.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+namespace {
+    // Increase scale factors significantly
+    constexpr float HEIGHT_SCALE = 500.0f;    // Increase height scale
+    constexpr float TERRAIN_SCALE = 50.0f;    // Increase horizontal scale
+
+    // Terrain within this distance of a trail point is levelled to the trail
+    constexpr float TRAIL_INFLUENCE_RADIUS = 10.0f * TERRAIN_SCALE;
+
+    // Largest patch whose (n + 1)^2 vertices fit 16-bit indices
+    constexpr int MAX_PATCH_SIZE = 255;
+
+    // Chunk strips keep the last 16-bit index free for primitive restart
+    constexpr GLushort PRIMITIVE_RESTART_INDEX = 0xFFFF;
+
+    // Entries of the post-transform vertex cache that indices are optimized
+    // for and measured against. Recent GPUs reuse at least this many.
+    constexpr int VERTEX_CACHE_SIZE = 32;
+
+    // Length of the morphConsts array in the vertex shader
+    constexpr int MAX_LOD_LEVELS = 16;
+
+    // Largest piece of a staged buffer or texture handed to GL at once, small
+    // enough that uploadStep overshoots its budget by well under a millisecond
+    constexpr size_t UPLOAD_SLICE_BYTES = 1 << 20;
+
+    // Occlusion bake quality check: samples compared against a reference
+    // search in this many directions
+    constexpr int OCCLUSION_CHECK_SAMPLES = 1024;
+    constexpr int OCCLUSION_REFERENCE_DIRECTIONS = 64;
+
+    // Octahedral encoding: project onto |x| + |y| + |z| = 1 and fold the
+    // lower half over the diagonals. Returns the (x, z) pair as snorm8.
+    void encodeOctahedral(const glm::vec3& n, GLbyte out[2]) {
+        float invL1 = 1.0f / (std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z));
+        float px = n.x * invL1;
+        float pz = n.z * invL1;
+        if (n.y < 0.0f) {
+            float foldedX = (1.0f - std::fabs(pz)) * (px >= 0.0f ? 1.0f : -1.0f);
+            float foldedZ = (1.0f - std::fabs(px)) * (pz >= 0.0f ? 1.0f : -1.0f);
+            px = foldedX;
+            pz = foldedZ;
+        }
+        out[0] = static_cast<GLbyte>(std::lround(px * 127.0f));
+        out[1] = static_cast<GLbyte>(std::lround(pz * 127.0f));
+    }
+
+    // Copies grid-ordered vertices into the chunk-contiguous order of the
+    // chunk index layouts, duplicating the vertices on chunk borders
+    template <typename T>
+    std::vector<T> gatherChunkVertices(const std::vector<T>& gridVertices, int width,
+        const std::vector<TerrainChunk>& chunks) {
+        const TerrainChunk& last = chunks.back();
+        std::vector<T> chunkVertices(last.baseVertex + static_cast<size_t>(last.quadsX + 1) * (last.quadsZ + 1));
+        for (const auto& chunk : chunks) {
+            T* out = chunkVertices.data() + chunk.baseVertex;
+            for (int z = chunk.z0; z <= chunk.z0 + chunk.quadsZ; ++z) {
+                const T* row = gridVertices.data() + static_cast<size_t>(z) * width + chunk.x0;
+                out = std::copy(row, row + chunk.quadsX + 1, out);
+            }
+        }
+        return chunkVertices;
+    }
+
+    // Key of a pyramid tile in Terrain::residentTiles
+    uint64_t tileKey(int level, int tileX, int tileZ) {
+        return (static_cast<uint64_t>(level) << 56) | (static_cast<uint64_t>(tileZ) << 28) | static_cast<uint64_t>(tileX);
+    }
+}
+
 Terrain::Terrain()
     : vertices(std::make_unique<std::vector<Vertex>>())
     , indices(std::make_unique<std::vector<unsigned int>>())
@@ -19,16 +105,297 @@ Terrain::~Terrain() {
 
 bool Terrain::initialize(const std::string& heightMapPath,
     const std::string& texturePath,
-    const std::vector<glm::vec3>& hikingData) {
+    const std::vector<glm::vec3>& hikingData,
+    const TerrainSettings& terrainSettings) {
+    if (!prepare(heightMapPath, texturePath, hikingData, terrainSettings)) {
+        return false;
+    }
+
+    // No frame to keep responsive: upload everything at once
+    while (!isReady()) {
+        if (!uploadStep(std::numeric_limits<double>::infinity())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Terrain::prepare(const std::string& heightMapPath,
+    const std::string& texturePath,
+    const std::vector<glm::vec3>& hikingData,
+    const TerrainSettings& terrainSettings) {
+
+    settings = terrainSettings;
+    uploadStage = UploadStage::Shader;
+
+    // Patch and chunk vertices are addressed with 16-bit indices
+    if (settings.renderMode != TerrainRenderMode::Mesh) {
+        settings.chunkSize = std::min(settings.chunkSize, MAX_PATCH_SIZE);
+        settings.lodPatchSize = std::min(settings.lodPatchSize, MAX_PATCH_SIZE);
+    }
+    else if (settings.indexLayout != TerrainIndexLayout::Triangles) {
+        settings.chunkSize = std::min(settings.chunkSize, MAX_PATCH_SIZE - 1);
+    }
+
+    if (settings.renderMode == TerrainRenderMode::Streaming && !settings.materials.empty()) {
+        std::cerr << "Material splatting needs the whole height grid; Streaming mode draws the single texture" << std::endl;
+        settings.materials.clear();
+    }
+
+    // The textures decode on workers of their own, one each, while the
+    // height grid is loaded and meshed here
+    ImageLoader textureDecoder(static_cast<unsigned int>(std::max<size_t>(settings.materials.size(), 1)));
+    if (settings.materials.empty()) {
+        textureDecoder.request(texturePath);
+    }
+    for (const auto& material : settings.materials) {
+        textureDecoder.request(material.texturePath, 3);
+    }
+
+    if (settings.renderMode == TerrainRenderMode::Streaming) {
+        // Nothing to build: tiles come from the pyramid as they are needed
+        if (!openHeightPyramid(heightMapPath)) {
+            return false;
+        }
+    }
+    else {
+        // A cached build of the same inputs skips decoding and meshing entirely
+        auto cache = std::make_shared<TerrainCache>();
+        meshCacheFile.clear();
+        if (!settings.meshCacheDirectory.empty()) {
+            meshCacheFile = meshCachePath(heightMapPath, hikingData);
+        }
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!meshCacheFile.empty() && cache->open(meshCacheFile, meshCacheKey) && restoreFromCache(cache->getData())) {
+            auto loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart);
+            std::cout << "Terrain loaded from cache " << meshCacheFile << " in " << loadTime.count() << " ms" << std::endl;
+            meshCacheFile.clear();
+        }
+        else {
+            cache->close();
+            if (!buildTerrain(heightMapPath, hikingData)) {
+                return false;
+            }
+        }
+
+        // Baked occlusion comes with a cache hit, otherwise it is baked now
+        if (cache->getData().occlusion) {
+            occlusionUpload = { cache, cache->getData().occlusion, cache->getData().occlusionBytes };
+        }
+        else if (settings.bakeOcclusion) {
+            bakeOcclusion();
+        }
+
+        if (settings.renderMode == TerrainRenderMode::Mesh) {
+            const TerrainCacheData& cached = cache->getData();
+            if (cached.vertexData) {
+                // Straight from the mapped file to the GPU; the uploads keep it mapped
+                vertexUpload = { cache, static_cast<const unsigned char*>(cached.vertexData), cached.vertexBytes };
+                indexUpload = { cache, static_cast<const unsigned char*>(cached.indexData), cached.indexBytes };
+            }
+            else {
+                stageMeshBuffers();
+            }
+        }
+        else {
+            stageHeightmapTexels();
+            if (!meshCacheFile.empty()) {
+                saveMeshCache(nullptr, 0, nullptr, 0);
+            }
+        }
+        meshCacheFile.clear();
+    }
 
-    // Load shaders
-    if (!shader->load(
-        "A:/Taief/Project/OpenGL_Project/shaders/vertex_shader.glsl",
-        "A:/Taief/Project/OpenGL_Project/shaders/fragment_shader.glsl")) {
-        std::cerr << "Failed to load terrain shaders" << std::endl;
+    // Staging the textures needs the height grid (for the splat map) done
+    std::vector<DecodedImage> textures = textureDecoder.waitAll();
+    if (!settings.materials.empty()) {
+        return stageMaterials(textures);
+    }
+    if (!stageTexture(textures.front())) {
+        std::cerr << "Failed to load texture: " << texturePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Terrain::uploadStep(double budgetMs) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point deadline = budgetMs == std::numeric_limits<double>::infinity()
+        ? Clock::time_point::max()
+        : Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(budgetMs));
+
+    while (uploadStage != UploadStage::Ready) {
+        switch (uploadStage) {
+        case UploadStage::Shader:
+            if (!shader->load(
+                "A:/Taief/Project/OpenGL_Project/shaders/vertex_shader.glsl",
+                "A:/Taief/Project/OpenGL_Project/shaders/fragment_shader.glsl")) {
+                std::cerr << "Failed to load terrain shaders" << std::endl;
+                return false;
+            }
+            uploadStage = UploadStage::Objects;
+            break;
+        case UploadStage::Objects:
+            createGpuObjects();
+            uploadStage = UploadStage::Data;
+            break;
+        case UploadStage::Data:
+            if (!uploadStagedData(deadline)) {
+                return true;
+            }
+            uploadStage = UploadStage::Finish;
+            break;
+        case UploadStage::Finish:
+            if (terrainTexture) {
+                glBindTexture(GL_TEXTURE_2D, terrainTexture);
+                glGenerateMipmap(GL_TEXTURE_2D);
+            }
+            if (materialTexture) {
+                glBindTexture(GL_TEXTURE_2D_ARRAY, materialTexture);
+                glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            }
+            vertexUpload = UploadSource();
+            indexUpload = UploadSource();
+            heightTexelUpload = UploadSource();
+            textureUpload = UploadSource();
+            materialUpload = UploadSource();
+            splatUpload = UploadSource();
+            occlusionUpload = UploadSource();
+            uploadStage = UploadStage::Ready;
+            break;
+        case UploadStage::Ready:
+            break;
+        }
+        if (Clock::now() >= deadline) break;
+    }
+    return true;
+}
+
+void Terrain::createGpuObjects() {
+    // Storage only; the texels follow in slices
+    if (settings.materials.empty()) {
+        glGenTextures(1, &terrainTexture);
+        glBindTexture(GL_TEXTURE_2D, terrainTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, textureFormat, textureWidth, textureHeight, 0, textureFormat, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else {
+        createMaterialTexture();
+        createSplatTexture();
+    }
+    if (occlusionUpload.bytes) {
+        createOcclusionTexture();
+    }
+
+    switch (settings.renderMode) {
+    case TerrainRenderMode::Mesh:
+        createMeshBuffers(vertexUpload.bytes, indexUpload.bytes);
+        break;
+    case TerrainRenderMode::GpuDisplaced:
+    case TerrainRenderMode::Cdlod:
+        setupPatchBuffers(settings.renderMode == TerrainRenderMode::Cdlod
+            ? quadtree.getPatchSize() : std::max(settings.chunkSize, 2));
+        createHeightmapTexture();
+        break;
+    case TerrainRenderMode::Streaming:
+        setupTileTexture();
+        setupPatchBuffers(pyramid->getTileSize());
+        break;
+    }
+}
+
+bool Terrain::uploadStagedData(std::chrono::steady_clock::time_point deadline) {
+    // Buffers go through the copy target so the VAO's bindings are left alone
+    auto bufferUpload = [](GLuint buffer, const UploadSource& source) {
+        return [buffer, &source](size_t offset, size_t bytes) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, source.data + offset);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        };
+    };
+    if (!drainUpload(vertexUpload, 1, deadline, bufferUpload(VBO, vertexUpload)) ||
+        !drainUpload(indexUpload, 1, deadline, bufferUpload(EBO, indexUpload))) {
         return false;
     }
 
+    // Textures in whole rows
+    const size_t heightRowBytes = static_cast<size_t>(terrainWidth) * sizeof(GLushort);
+    bool heightsDone = drainUpload(heightTexelUpload, heightRowBytes, deadline, [&](size_t offset, size_t bytes) {
+        glBindTexture(GL_TEXTURE_2D, heightmapTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(offset / heightRowBytes), terrainWidth,
+            static_cast<GLsizei>(bytes / heightRowBytes), GL_RED, GL_UNSIGNED_SHORT, heightTexelUpload.data + offset);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    });
+    if (!heightsDone) return false;
+
+    const size_t textureRowBytes = static_cast<size_t>(textureWidth) * (textureFormat == GL_RGBA ? 4 : 3);
+    bool textureDone = drainUpload(textureUpload, textureRowBytes, deadline, [&](size_t offset, size_t bytes) {
+        glBindTexture(GL_TEXTURE_2D, terrainTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(offset / textureRowBytes), textureWidth,
+            static_cast<GLsizei>(bytes / textureRowBytes), textureFormat, GL_UNSIGNED_BYTE, textureUpload.data + offset);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    });
+    if (!textureDone) return false;
+
+    bool materialsDone = drainUpload(materialUpload, static_cast<size_t>(materialWidth) * 3, deadline,
+        [&](size_t offset, size_t bytes) {
+            uploadTextureArrayRows(materialTexture, materialWidth, materialHeight, GL_RGB, 3, materialUpload, offset, bytes);
+        });
+    if (!materialsDone) return false;
+
+    bool occlusionDone = drainUpload(occlusionUpload, static_cast<size_t>(terrainWidth), deadline,
+        [&](size_t offset, size_t bytes) { uploadOcclusionRows(offset, bytes); });
+    if (!occlusionDone) return false;
+
+    return drainUpload(splatUpload, static_cast<size_t>(terrainWidth) * 4, deadline, [&](size_t offset, size_t bytes) {
+        uploadTextureArrayRows(splatTexture, terrainWidth, terrainHeight, GL_RGBA, 4, splatUpload, offset, bytes);
+    });
+}
+
+void Terrain::uploadTextureArrayRows(GLuint texture, int width, int height, GLenum format, size_t texelBytes,
+    const UploadSource& source, size_t offset, size_t bytes) {
+    // Rows run on from the last row of one layer into the first of the next
+    const size_t rowBytes = static_cast<size_t>(width) * texelBytes;
+    size_t row = offset / rowBytes;
+    const size_t rowEnd = (offset + bytes) / rowBytes;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    while (row < rowEnd) {
+        GLint layer = static_cast<GLint>(row / height);
+        GLint y = static_cast<GLint>(row % height);
+        size_t rows = std::min(rowEnd - row, static_cast<size_t>(height - y));
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, y, layer, width, static_cast<GLsizei>(rows), 1,
+            format, GL_UNSIGNED_BYTE, source.data + row * rowBytes);
+        row += rows;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+bool Terrain::drainUpload(UploadSource& source, size_t granularity, std::chrono::steady_clock::time_point deadline,
+    const std::function<void(size_t, size_t)>& upload) {
+    if (source.uploaded >= source.bytes) return true;
+
+    // Every call uploads at least one slice, so even a spent budget makes progress
+    const size_t sliceBytes = std::max(UPLOAD_SLICE_BYTES / granularity, static_cast<size_t>(1)) * granularity;
+    while (source.uploaded < source.bytes) {
+        size_t bytes = std::min(sliceBytes, source.bytes - source.uploaded);
+        upload(source.uploaded, bytes);
+        source.uploaded += bytes;
+        if (source.uploaded < source.bytes && std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Terrain::buildTerrain(const std::string& heightMapPath, const std::vector<glm::vec3>& hikingData) {
     int width, height;
     std::vector<unsigned char> heightData;
 
@@ -40,16 +407,179 @@ bool Terrain::initialize(const std::string& heightMapPath,
     terrainWidth = width;
     terrainHeight = height;
 
-    generateTerrainVertices(heightData, width, height, hikingData);
-    generateTerrainIndices(width, height);
-    calculateNormals();
+    auto buildStart = std::chrono::steady_clock::now();
+    if (settings.parallelMeshBuild) {
+        buildPool = std::make_unique<ThreadPool>(settings.workerThreads);
+    }
 
-    if (!loadTexture(texturePath)) {
-        std::cerr << "Failed to load texture: " << texturePath << std::endl;
+    buildHeightGrid(heightData, width, height, hikingData);
+    switch (settings.renderMode) {
+    case TerrainRenderMode::Mesh:
+        generateTerrainVertices(width, height);
+        buildChunks(width, height);
+        if (settings.indexLayout != TerrainIndexLayout::Triangles) {
+            if (settings.simplifyMaxError > 0.0f) {
+                std::cerr << "Terrain simplification needs the Triangles index layout, ignoring it" << std::endl;
+            }
+            generateChunkIndices();
+        }
+        else if (settings.simplifyMaxError > 0.0f) {
+            simplifyTerrain(width, height);
+        }
+        else {
+            generateTerrainIndices(width);
+        }
+        if (settings.optimizeVertexCache && settings.indexLayout != TerrainIndexLayout::ChunkStrips) {
+            optimizeIndexOrder();
+        }
+        calculateNormals();
+        if (settings.vertexFormat == TerrainVertexFormat::Packed) {
+            packVertices();
+        }
+        if (settings.indexLayout == TerrainIndexLayout::Triangles && settings.simplifyMaxError > 0.0f) {
+            compactVertices();
+        }
+        break;
+    case TerrainRenderMode::GpuDisplaced:
+        buildChunks(width, height);
+        break;
+    case TerrainRenderMode::Cdlod:
+        buildLodQuadtree();
+        break;
+    case TerrainRenderMode::Streaming:
+        // Nothing to build, see openHeightPyramid
+        break;
+    }
+
+    unsigned int buildThreads = buildPool ? buildPool->size() : 1;
+    buildPool.reset();
+    auto buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart);
+    std::cout << "Terrain mesh built in " << buildTime.count() << " ms using "
+        << buildThreads << " thread(s)" << std::endl;
+
+    return true;
+}
+
+bool Terrain::restoreFromCache(const TerrainCacheData& cached) {
+    terrainWidth = cached.width;
+    terrainHeight = cached.height;
+    minHeight = cached.minHeight;
+    maxHeight = cached.maxHeight;
+    heightGrid.assign(cached.heights, cached.heights + static_cast<size_t>(cached.width) * cached.height);
+    raycaster.build(heightGrid, terrainWidth, terrainHeight, TERRAIN_SCALE);
+
+    switch (settings.renderMode) {
+    case TerrainRenderMode::Mesh:
+        if (!cached.vertexData || !cached.indexData) return false;
+        chunks.assign(cached.chunks, cached.chunks + cached.chunkCount);
+        numIndices = cached.indexCount;
+        break;
+    case TerrainRenderMode::GpuDisplaced:
+        buildChunks(terrainWidth, terrainHeight);
+        break;
+    case TerrainRenderMode::Cdlod:
+        buildLodQuadtree();
+        break;
+    case TerrainRenderMode::Streaming:
+        return false;
+    }
+    return true;
+}
+
+std::string Terrain::meshCachePath(const std::string& heightMapPath, const std::vector<glm::vec3>& hikingData) {
+    // Key: the height map file, the trail and every constant and setting
+    // that changes the result
+    MappedFile heightMapFile;
+    if (!heightMapFile.open(heightMapPath)) {
+        return std::string();
+    }
+    uint64_t key = hashBytes(heightMapFile.data(), heightMapFile.size());
+    if (!hikingData.empty()) {
+        key = hashBytes(hikingData.data(), hikingData.size() * sizeof(glm::vec3), key);
+    }
+
+    const float constants[] = { HEIGHT_SCALE, TERRAIN_SCALE, TRAIL_INFLUENCE_RADIUS, settings.simplifyMaxError };
+    const int options[] = { static_cast<int>(settings.renderMode), static_cast<int>(settings.vertexFormat),
+        static_cast<int>(settings.indexLayout), settings.chunkSize, settings.optimizeVertexCache ? 1 : 0,
+        settings.bakeOcclusion ? 1 : 0, settings.occlusionDirections, settings.occlusionRadius };
+    key = hashBytes(constants, sizeof(constants), key);
+    meshCacheKey = hashBytes(options, sizeof(options), key);
+
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "terrain_%016llx.bin", static_cast<unsigned long long>(meshCacheKey));
+    return settings.meshCacheDirectory + "/" + fileName;
+}
+
+void Terrain::saveMeshCache(const void* vertexData, size_t vertexBytes, const void* indexData, size_t indexBytes) {
+    TerrainCacheData data;
+    data.width = terrainWidth;
+    data.height = terrainHeight;
+    data.minHeight = minHeight;
+    data.maxHeight = maxHeight;
+    data.heights = heightGrid.data();
+    data.occlusion = occlusionUpload.data;
+    data.occlusionBytes = occlusionUpload.bytes;
+    if (settings.renderMode == TerrainRenderMode::Mesh) {
+        data.chunks = chunks.data();
+        data.chunkCount = chunks.size();
+        data.indexCount = numIndices;
+        data.vertexData = vertexData;
+        data.vertexBytes = vertexBytes;
+        data.indexData = indexData;
+        data.indexBytes = indexBytes;
+    }
+
+    if (TerrainCache::write(meshCacheFile, meshCacheKey, data)) {
+        std::cout << "Terrain cache written to " << meshCacheFile << std::endl;
+    }
+}
+
+bool Terrain::reloadHeightMap(const std::string& heightMapPath, const std::vector<glm::vec3>& hikingData) {
+    if (settings.renderMode == TerrainRenderMode::Mesh || settings.renderMode == TerrainRenderMode::Streaming) {
+        std::cerr << "Reloading a height map needs the GpuDisplaced or Cdlod render mode" << std::endl;
+        return false;
+    }
+
+    int width, height;
+    std::vector<unsigned char> heightData;
+    if (!loadHeightMap(heightMapPath, width, height, heightData)) {
+        std::cerr << "Failed to load height map: " << heightMapPath << std::endl;
         return false;
     }
 
-    setupBuffers();
+    terrainWidth = width;
+    terrainHeight = height;
+
+    if (settings.parallelMeshBuild) {
+        buildPool = std::make_unique<ThreadPool>(settings.workerThreads);
+    }
+    buildHeightGrid(heightData, width, height, hikingData);
+    if (settings.renderMode == TerrainRenderMode::Cdlod) {
+        buildLodQuadtree();
+    }
+    else {
+        buildChunks(width, height);
+    }
+    buildPool.reset();
+
+    // The patch buffers do not depend on the area, only the textures change
+    uploadHeightmapTexture();
+    if (!settings.materials.empty()) {
+        stageSplatMap();
+        createSplatTexture();
+        drainUpload(splatUpload, static_cast<size_t>(terrainWidth) * 4, std::chrono::steady_clock::time_point::max(),
+            [&](size_t offset, size_t bytes) {
+                uploadTextureArrayRows(splatTexture, terrainWidth, terrainHeight, GL_RGBA, 4, splatUpload, offset, bytes);
+            });
+        splatUpload = UploadSource();
+    }
+    if (occlusionTexture) {
+        bakeOcclusion();
+        glBindTexture(GL_TEXTURE_2D, occlusionTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, terrainWidth, terrainHeight, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        uploadOcclusionRows(0, occlusionUpload.bytes);
+        occlusionUpload = UploadSource();
+    }
     return true;
 }
 
@@ -67,191 +597,1288 @@ bool Terrain::loadHeightMap(const std::string& path, int& width, int& height,
     return true;
 }
 
-bool Terrain::loadTexture(const std::string& path) {
-    int texWidth, texHeight, texChannels;
-    unsigned char* texData = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, 0);
-    if (!texData) {
-        std::cerr << "Failed to load texture: " << stbi_failure_reason() << std::endl;
+bool Terrain::stageTexture(const DecodedImage& image) {
+    // Always 3 or 4 channels, so every row matches textureFormat
+    if (!image.pixels) {
+        std::cerr << "Failed to load texture: " << image.error << std::endl;
         return false;
     }
 
-    glGenTextures(1, &terrainTexture);
-    glBindTexture(GL_TEXTURE_2D, terrainTexture);
+    textureWidth = image.width;
+    textureHeight = image.height;
+    textureFormat = image.channels == 4 ? GL_RGBA : GL_RGB;
+    textureUpload = { image.pixels, image.pixels.get(), image.getBytes() };
+    return true;
+}
 
-    GLenum format = texChannels == 4 ? GL_RGBA : GL_RGB;
-    glTexImage2D(GL_TEXTURE_2D, 0, format, texWidth, texHeight, 0, format, GL_UNSIGNED_BYTE, texData);
-    glGenerateMipmap(GL_TEXTURE_2D);
+bool Terrain::stageMaterials(const std::vector<DecodedImage>& layers) {
+    auto texels = std::make_shared<std::vector<unsigned char>>();
+    if (!packMaterialLayers(layers, materialWidth, materialHeight, *texels)) {
+        return false;
+    }
+    materialUpload = { texels, texels->data(), texels->size() };
+    stageSplatMap();
+    return true;
+}
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void Terrain::stageSplatMap() {
+    auto splatStart = std::chrono::steady_clock::now();
+    auto splat = std::make_shared<std::vector<unsigned char>>(
+        static_cast<size_t>(terrainWidth) * terrainHeight * 4 * getSplatLayerCount());
+    if (settings.parallelMeshBuild) {
+        buildPool = std::make_unique<ThreadPool>(settings.workerThreads);
+    }
+    forEachRowBand(terrainHeight, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; ++z) {
+            computeSplatRow(heightGrid.data(), terrainWidth, terrainHeight, TERRAIN_SCALE, minHeight, maxHeight,
+                settings.materials, z, splat->data());
+        }
+    });
+    buildPool.reset();
+    splatUpload = { splat, splat->data(), splat->size() };
 
-    stbi_image_free(texData);
-    return true;
+    auto splatTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - splatStart);
+    std::cout << "Splat map of " << settings.materials.size() << " materials over " << terrainWidth << "x"
+        << terrainHeight << " samples built in " << splatTime.count() << " ms" << std::endl;
+}
+
+void Terrain::bakeOcclusion() {
+    auto bakeStart = std::chrono::steady_clock::now();
+    OcclusionBaker baker(heightGrid.data(), terrainWidth, terrainHeight, TERRAIN_SCALE,
+        settings.occlusionDirections, settings.occlusionRadius);
+    auto occlusion = std::make_shared<std::vector<unsigned char>>(static_cast<size_t>(terrainWidth) * terrainHeight);
+    if (settings.parallelMeshBuild) {
+        buildPool = std::make_unique<ThreadPool>(settings.workerThreads);
+    }
+    unsigned int bakeThreads = buildPool ? buildPool->size() : 1;
+    forEachRowBand(terrainHeight, [&](int zBegin, int zEnd) {
+        baker.bakeRows(zBegin, zEnd, occlusion->data());
+    });
+    buildPool.reset();
+    auto bakeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart);
+    occlusionUpload = { occlusion, occlusion->data(), occlusion->size() };
+
+    // Quality: the error against a far finer search, at samples spread
+    // over the grid along a golden-ratio sequence
+    double sum = 0.0;
+    unsigned char darkest = 255;
+    for (unsigned char value : *occlusion) {
+        sum += value;
+        darkest = std::min(darkest, value);
+    }
+    double errorSum = 0.0;
+    float errorMax = 0.0f;
+    for (int i = 0; i < OCCLUSION_CHECK_SAMPLES; ++i) {
+        double spread = std::fmod(i * 0.6180339887, 1.0);
+        int x = std::min(static_cast<int>(spread * terrainWidth), terrainWidth - 1);
+        int z = std::min(i * terrainHeight / OCCLUSION_CHECK_SAMPLES, terrainHeight - 1);
+        float baked = (*occlusion)[static_cast<size_t>(z) * terrainWidth + x] / 255.0f;
+        float error = std::abs(baked - baker.reference(x, z, OCCLUSION_REFERENCE_DIRECTIONS));
+        errorSum += error;
+        errorMax = std::max(errorMax, error);
+    }
+
+    std::cout << "Occlusion baked for " << terrainWidth << "x" << terrainHeight << " samples in "
+        << bakeTime.count() << " ms using " << bakeThreads << " thread(s): " << settings.occlusionDirections
+        << " directions x " << baker.getStepsPerDirection() << " steps, visible sky mean "
+        << sum / (255.0 * occlusion->size()) << ", min " << darkest / 255.0f << "; error against "
+        << OCCLUSION_REFERENCE_DIRECTIONS << " directions at every step: mean "
+        << errorSum / OCCLUSION_CHECK_SAMPLES << ", max " << errorMax << std::endl;
+}
+
+void Terrain::forEachRowBand(int rows, const std::function<void(int, int)>& fn) {
+    if (buildPool) {
+        buildPool->parallelFor(0, rows, fn);
+    }
+    else {
+        fn(0, rows);
+    }
 }
 
-void Terrain::generateTerrainVertices(const std::vector<unsigned char>& heightData,
+void Terrain::buildHeightGrid(const std::vector<unsigned char>& heightData,
     int width, int height,
     const std::vector<glm::vec3>& hikingData) {
 
-    // Increase scale factors significantly
-    const float HEIGHT_SCALE = 500.0f;    // Increase height scale
-    const float TERRAIN_SCALE = 50.0f;    // Increase horizontal scale
+    // Every row band writes straight into its own slots of the output
+    heightGrid.resize(static_cast<size_t>(width) * height);
 
-    vertices->clear();
-    vertices->reserve(width * height);
+    forEachRowBand(height, [&](int zBegin, int zEnd) {
+        for (size_t i = static_cast<size_t>(zBegin) * width; i < static_cast<size_t>(zEnd) * width; ++i) {
+            heightGrid[i] = static_cast<float>(heightData[i]) / 255.0f * HEIGHT_SCALE;
+        }
+    });
+
+    // Adjust elevation based on hiking data
+    flattenUnderTrail(width, height, hikingData);
 
     minHeight = std::numeric_limits<float>::max();
     maxHeight = std::numeric_limits<float>::lowest();
+    std::mutex rangeMutex;
+    forEachRowBand(height, [&](int zBegin, int zEnd) {
+        float bandMin = std::numeric_limits<float>::max();
+        float bandMax = std::numeric_limits<float>::lowest();
+        for (size_t i = static_cast<size_t>(zBegin) * width; i < static_cast<size_t>(zEnd) * width; ++i) {
+            bandMin = std::min(bandMin, heightGrid[i]);
+            bandMax = std::max(bandMax, heightGrid[i]);
+        }
+        std::lock_guard<std::mutex> lock(rangeMutex);
+        minHeight = std::min(minHeight, bandMin);
+        maxHeight = std::max(maxHeight, bandMax);
+    });
 
-    for (int z = 0; z < height; ++z) {
-        for (int x = 0; x < width; ++x) {
-            float xPos = (x - width / 2) * TERRAIN_SCALE;   // Center the terrain
-            float zPos = (z - height / 2) * TERRAIN_SCALE;  // Center the terrain
+    raycaster.build(heightGrid, width, height, TERRAIN_SCALE);
+}
+
+void Terrain::generateTerrainVertices(int width, int height) {
+    // Every row band writes straight into its own slots of the output
+    vertices->resize(static_cast<size_t>(width) * height);
+
+    forEachRowBand(height, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; ++z) {
+            for (int x = 0; x < width; ++x) {
+                float xPos = (x - width / 2) * TERRAIN_SCALE;   // Center the terrain
+                float zPos = (z - height / 2) * TERRAIN_SCALE;  // Center the terrain
+
+                Vertex& vertex = (*vertices)[z * width + x];
+                vertex.position = glm::vec3(xPos, heightGrid[z * width + x], zPos);
+                vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+                vertex.texCoords = glm::vec2(static_cast<float>(x) / width,
+                    static_cast<float>(z) / height);
+            }
+        }
+    });
+}
 
-            unsigned char pixel = heightData[z * width + x];
-            float elevation = static_cast<float>(pixel) / 255.0f * HEIGHT_SCALE;
+void Terrain::flattenUnderTrail(int width, int height, const std::vector<glm::vec3>& hikingData) {
+    if (hikingData.empty()) return;
 
-            // Adjust elevation based on hiking data
-            for (const auto& point : hikingData) {
-                float distance = glm::distance(glm::vec2(xPos, zPos), glm::vec2(point.x, point.z));
-                if (distance < 10.0f * TERRAIN_SCALE) {
-                    elevation = point.y * HEIGHT_SCALE;
+    // Cells are as wide as the influence radius, so only grid vertices in
+    // cells next to the trail can be affected and each query scans 3x3 cells
+    TrailIndex trailIndex;
+    trailIndex.build(hikingData, TRAIL_INFLUENCE_RADIUS);
+
+    trailIndex.forEachInfluencedCell([&](const glm::ivec2& cell, const glm::vec2& cellMin, const glm::vec2& cellMax) {
+        // Grid range covering the cell, widened by one vertex against rounding;
+        // vertices that fall in a neighbouring cell are skipped below
+        int x0 = std::max(static_cast<int>(std::floor(cellMin.x / TERRAIN_SCALE)) + width / 2 - 1, 0);
+        int x1 = std::min(static_cast<int>(std::ceil(cellMax.x / TERRAIN_SCALE)) + width / 2 + 1, width - 1);
+        int z0 = std::max(static_cast<int>(std::floor(cellMin.y / TERRAIN_SCALE)) + height / 2 - 1, 0);
+        int z1 = std::min(static_cast<int>(std::ceil(cellMax.y / TERRAIN_SCALE)) + height / 2 + 1, height - 1);
+
+        for (int z = z0; z <= z1; ++z) {
+            for (int x = x0; x <= x1; ++x) {
+                glm::vec2 pos((x - width / 2) * TERRAIN_SCALE, (z - height / 2) * TERRAIN_SCALE);
+                if (trailIndex.cellOf(pos) != cell) continue;
+
+                // The last trail point within range wins, as in trail order
+                int pointIndex = trailIndex.findLastWithin(pos, TRAIL_INFLUENCE_RADIUS);
+                if (pointIndex >= 0) {
+                    heightGrid[static_cast<size_t>(z) * width + x] = hikingData[pointIndex].y * HEIGHT_SCALE;
                 }
             }
+        }
+    });
+}
 
-            minHeight = std::min(minHeight, elevation);
-            maxHeight = std::max(maxHeight, elevation);
+void Terrain::buildChunks(int width, int height) {
+    // Quads are grouped into square chunks, each owning a contiguous index
+    // range, so a chunk can be culled and drawn on its own
+    const int quadsX = width - 1;
+    const int quadsZ = height - 1;
+    const int chunkSize = std::max(settings.chunkSize, 1);
+    const int chunksX = (quadsX + chunkSize - 1) / chunkSize;
+    const int chunksZ = (quadsZ + chunkSize - 1) / chunkSize;
 
-            Vertex vertex;
-            vertex.position = glm::vec3(xPos, elevation, zPos);
-            vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
-            vertex.texCoords = glm::vec2(static_cast<float>(x) / width,
-                static_cast<float>(z) / height);
-            vertices->push_back(vertex);
+    chunks.assign(static_cast<size_t>(chunksX) * chunksZ, TerrainChunk{});
+    size_t indexCount = 0;
+    for (int cz = 0; cz < chunksZ; ++cz) {
+        for (int cx = 0; cx < chunksX; ++cx) {
+            TerrainChunk& chunk = chunks[cz * chunksX + cx];
+            chunk.x0 = cx * chunkSize;
+            chunk.z0 = cz * chunkSize;
+            chunk.quadsX = std::min(chunkSize, quadsX - chunk.x0);
+            chunk.quadsZ = std::min(chunkSize, quadsZ - chunk.z0);
+            chunk.firstIndex = static_cast<unsigned int>(indexCount);
+            chunk.indexCount = static_cast<unsigned int>(chunk.quadsX * chunk.quadsZ * 6);
+            indexCount += chunk.indexCount;
         }
     }
+
+    forEachRowBand(static_cast<int>(chunks.size()), [&](int chunkBegin, int chunkEnd) {
+        for (int c = chunkBegin; c < chunkEnd; ++c) {
+            TerrainChunk& chunk = chunks[c];
+            float chunkMin = std::numeric_limits<float>::max();
+            float chunkMax = std::numeric_limits<float>::lowest();
+            for (int z = chunk.z0; z <= chunk.z0 + chunk.quadsZ; ++z) {
+                for (int x = chunk.x0; x <= chunk.x0 + chunk.quadsX; ++x) {
+                    float elevation = heightGrid[static_cast<size_t>(z) * width + x];
+                    chunkMin = std::min(chunkMin, elevation);
+                    chunkMax = std::max(chunkMax, elevation);
+                }
+            }
+
+            chunk.boundsMin = glm::vec3((chunk.x0 - width / 2) * TERRAIN_SCALE, chunkMin,
+                (chunk.z0 - height / 2) * TERRAIN_SCALE);
+            chunk.boundsMax = glm::vec3((chunk.x0 + chunk.quadsX - width / 2) * TERRAIN_SCALE, chunkMax,
+                (chunk.z0 + chunk.quadsZ - height / 2) * TERRAIN_SCALE);
+        }
+    });
 }
 
-void Terrain::generateTerrainIndices(int width, int height) {
-    indices->clear();
-    indices->reserve((width - 1) * (height - 1) * 6);
+void Terrain::generateTerrainIndices(int width) {
+    indices->resize(chunks.empty() ? 0 : chunks.back().firstIndex + chunks.back().indexCount);
 
-    for (int z = 0; z < height - 1; ++z) {
-        for (int x = 0; x < width - 1; ++x) {
-            unsigned int topLeft = z * width + x;
-            unsigned int topRight = topLeft + 1;
-            unsigned int bottomLeft = (z + 1) * width + x;
-            unsigned int bottomRight = bottomLeft + 1;
+    forEachRowBand(static_cast<int>(chunks.size()), [&](int chunkBegin, int chunkEnd) {
+        for (int c = chunkBegin; c < chunkEnd; ++c) {
+            const TerrainChunk& chunk = chunks[c];
+            unsigned int* out = indices->data() + chunk.firstIndex;
+            for (int z = chunk.z0; z < chunk.z0 + chunk.quadsZ; ++z) {
+                for (int x = chunk.x0; x < chunk.x0 + chunk.quadsX; ++x) {
+                    unsigned int topLeft = z * width + x;
+                    unsigned int topRight = topLeft + 1;
+                    unsigned int bottomLeft = (z + 1) * width + x;
+                    unsigned int bottomRight = bottomLeft + 1;
 
-            indices->push_back(topLeft);
-            indices->push_back(bottomLeft);
-            indices->push_back(topRight);
-            indices->push_back(topRight);
-            indices->push_back(bottomLeft);
-            indices->push_back(bottomRight);
+                    *out++ = topLeft;
+                    *out++ = bottomLeft;
+                    *out++ = topRight;
+                    *out++ = topRight;
+                    *out++ = bottomLeft;
+                    *out++ = bottomRight;
+                }
+            }
         }
+    });
+
+    numIndices = static_cast<unsigned int>(indices->size());
+}
+
+void Terrain::generateChunkIndices() {
+    // Chunks of equal size share one index range; there are at most four
+    // sizes (full, right edge, bottom edge, corner)
+    struct Pattern {
+        int quadsX;
+        int quadsZ;
+        unsigned int firstIndex;
+        unsigned int indexCount;
+    };
+    std::vector<Pattern> patterns;
+    const bool strips = settings.indexLayout == TerrainIndexLayout::ChunkStrips;
+
+    chunkIndices.clear();
+    GLint baseVertex = 0;
+    for (auto& chunk : chunks) {
+        auto pattern = std::find_if(patterns.begin(), patterns.end(), [&](const Pattern& p) {
+            return p.quadsX == chunk.quadsX && p.quadsZ == chunk.quadsZ;
+        });
+        if (pattern == patterns.end()) {
+            unsigned int firstIndex = static_cast<unsigned int>(chunkIndices.size());
+            const int rowVertices = chunk.quadsX + 1;
+            for (int z = 0; z < chunk.quadsZ; ++z) {
+                if (strips) {
+                    // Alternating top/bottom vertices give the same triangles
+                    // and winding as the list below
+                    for (int x = 0; x <= chunk.quadsX; ++x) {
+                        chunkIndices.push_back(static_cast<GLushort>(z * rowVertices + x));
+                        chunkIndices.push_back(static_cast<GLushort>((z + 1) * rowVertices + x));
+                    }
+                    chunkIndices.push_back(PRIMITIVE_RESTART_INDEX);
+                    continue;
+                }
+                for (int x = 0; x < chunk.quadsX; ++x) {
+                    GLushort topLeft = static_cast<GLushort>(z * rowVertices + x);
+                    GLushort topRight = topLeft + 1;
+                    GLushort bottomLeft = static_cast<GLushort>((z + 1) * rowVertices + x);
+                    GLushort bottomRight = bottomLeft + 1;
+
+                    chunkIndices.push_back(topLeft);
+                    chunkIndices.push_back(bottomLeft);
+                    chunkIndices.push_back(topRight);
+                    chunkIndices.push_back(topRight);
+                    chunkIndices.push_back(bottomLeft);
+                    chunkIndices.push_back(bottomRight);
+                }
+            }
+            patterns.push_back({ chunk.quadsX, chunk.quadsZ, firstIndex,
+                static_cast<unsigned int>(chunkIndices.size()) - firstIndex });
+            pattern = patterns.end() - 1;
+        }
+
+        chunk.firstIndex = pattern->firstIndex;
+        chunk.indexCount = pattern->indexCount;
+        chunk.baseVertex = baseVertex;
+        baseVertex += (chunk.quadsX + 1) * (chunk.quadsZ + 1);
+    }
+
+    numIndices = static_cast<unsigned int>(chunkIndices.size());
+}
+
+void Terrain::simplifyTerrain(int width, int height) {
+    auto start = std::chrono::steady_clock::now();
+    TerrainRtin rtin;
+    rtin.build(heightGrid, width, height);
+
+    std::vector<unsigned int> triangles;
+    rtin.extract(settings.simplifyMaxError, triangles);
+    float maxError = TerrainRtin::measureError(heightGrid, width, triangles);
+
+    // Triangles go to the chunk holding their centroid, sorted by chunk so
+    // each chunk still owns one contiguous index range. Large triangles can
+    // reach past their chunk, so the bounds grow to cover them.
+    const int chunkSize = std::max(settings.chunkSize, 1);
+    const int chunksX = (width - 1 + chunkSize - 1) / chunkSize;
+    const size_t triangleCount = triangles.size() / 3;
+    std::vector<unsigned int> triangleChunk(triangleCount);
+    std::vector<unsigned int> chunkTriangles(chunks.size() + 1, 0);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int xSum = 0, zSum = 0;
+        for (int k = 0; k < 3; ++k) {
+            xSum += triangles[t * 3 + k] % width;
+            zSum += triangles[t * 3 + k] / width;
+        }
+        int cx = std::min(xSum / 3 / chunkSize, chunksX - 1);
+        int cz = std::min(zSum / 3 / chunkSize, static_cast<int>(chunks.size()) / chunksX - 1);
+        triangleChunk[t] = cz * chunksX + cx;
+        ++chunkTriangles[triangleChunk[t] + 1];
     }
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        chunkTriangles[c + 1] += chunkTriangles[c];
+        chunks[c].firstIndex = chunkTriangles[c] * 3;
+        chunks[c].indexCount = (chunkTriangles[c + 1] - chunkTriangles[c]) * 3;
+    }
+
+    indices->resize(triangles.size());
+    for (size_t t = 0; t < triangleCount; ++t) {
+        TerrainChunk& chunk = chunks[triangleChunk[t]];
+        unsigned int* out = indices->data() + static_cast<size_t>(chunkTriangles[triangleChunk[t]]++) * 3;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int index = triangles[t * 3 + k];
+            out[k] = index;
 
+            glm::vec3 position((static_cast<int>(index % width) - width / 2) * TERRAIN_SCALE, heightGrid[index],
+                (static_cast<int>(index / width) - height / 2) * TERRAIN_SCALE);
+            chunk.boundsMin = glm::min(chunk.boundsMin, position);
+            chunk.boundsMax = glm::max(chunk.boundsMax, position);
+        }
+    }
     numIndices = static_cast<unsigned int>(indices->size());
+
+    auto simplifyTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    size_t fullTriangles = static_cast<size_t>(width - 1) * (height - 1) * 2;
+    std::cout << "Terrain simplified to " << triangleCount << " of " << fullTriangles << " triangles ("
+        << 100.0 * triangleCount / fullTriangles << "%), max error " << maxError << " m (limit "
+        << settings.simplifyMaxError << " m) in " << simplifyTime.count() << " ms" << std::endl;
 }
 
-void Terrain::calculateNormals() {
-    // Reset normals
-    for (auto& vertex : *vertices) {
-        vertex.normal = glm::vec3(0.0f);
+void Terrain::compactVertices() {
+    // The simplified mesh uses a fraction of the grid; keep only those
+    // vertices, in order of first use
+    std::vector<unsigned int> remap(vertices->size(), std::numeric_limits<unsigned int>::max());
+    std::vector<unsigned int> used;
+    for (auto& index : *indices) {
+        if (remap[index] == std::numeric_limits<unsigned int>::max()) {
+            remap[index] = static_cast<unsigned int>(used.size());
+            used.push_back(index);
+        }
+        index = remap[index];
     }
 
-    // Calculate normals
-    for (size_t i = 0; i < indices->size(); i += 3) {
-        unsigned int i0 = (*indices)[i];
-        unsigned int i1 = (*indices)[i + 1];
-        unsigned int i2 = (*indices)[i + 2];
+    std::vector<Vertex> kept(used.size());
+    for (size_t i = 0; i < used.size(); ++i) {
+        kept[i] = (*vertices)[used[i]];
+    }
+    vertices->swap(kept);
 
-        glm::vec3 v1 = (*vertices)[i1].position - (*vertices)[i0].position;
-        glm::vec3 v2 = (*vertices)[i2].position - (*vertices)[i0].position;
-        glm::vec3 normal = glm::normalize(glm::cross(v1, v2));
+    if (!packedVertices.empty()) {
+        std::vector<PackedVertex> compactPacked(used.size());
+        for (size_t i = 0; i < used.size(); ++i) {
+            compactPacked[i] = packedVertices[used[i]];
+        }
+        packedVertices.swap(compactPacked);
+    }
+}
 
-        (*vertices)[i0].normal += normal;
-        (*vertices)[i1].normal += normal;
-        (*vertices)[i2].normal += normal;
+void Terrain::optimizeIndexOrder() {
+    // Every index range that is drawn on its own: the chunks of the global
+    // list, or the shared ranges of the chunk layouts with how often each
+    // one is drawn
+    struct Range {
+        unsigned int firstIndex;
+        unsigned int indexCount;
+        size_t uses;
+    };
+    std::vector<Range> ranges;
+    for (const auto& chunk : chunks) {
+        if (settings.indexLayout != TerrainIndexLayout::Triangles) {
+            auto range = std::find_if(ranges.begin(), ranges.end(), [&](const Range& r) {
+                return r.firstIndex == chunk.firstIndex;
+            });
+            if (range != ranges.end()) {
+                ++range->uses;
+                continue;
+            }
+        }
+        ranges.push_back({ chunk.firstIndex, chunk.indexCount, 1 });
     }
 
-    // Normalize
-    for (auto& vertex : *vertices) {
-        vertex.normal = glm::normalize(vertex.normal);
+    auto measure = [&](VertexCacheModel model) {
+        size_t misses = 0;
+        size_t triangles = 0;
+        for (const auto& range : ranges) {
+            size_t rangeMisses = settings.indexLayout == TerrainIndexLayout::Triangles
+                ? countVertexCacheMisses(indices->data() + range.firstIndex, range.indexCount, VERTEX_CACHE_SIZE, model)
+                : countVertexCacheMisses(chunkIndices.data() + range.firstIndex, range.indexCount, VERTEX_CACHE_SIZE, model);
+            misses += rangeMisses * range.uses;
+            triangles += range.indexCount / 3 * range.uses;
+        }
+        return triangles ? static_cast<double>(misses) / triangles : 0.0;
+    };
+
+    double fifoBefore = measure(VertexCacheModel::Fifo);
+    double lruBefore = measure(VertexCacheModel::Lru);
+
+    auto start = std::chrono::steady_clock::now();
+    forEachRowBand(static_cast<int>(ranges.size()), [&](int rangeBegin, int rangeEnd) {
+        for (int r = rangeBegin; r < rangeEnd; ++r) {
+            if (settings.indexLayout == TerrainIndexLayout::Triangles) {
+                optimizeVertexCache(indices->data() + ranges[r].firstIndex, ranges[r].indexCount, VERTEX_CACHE_SIZE);
+            }
+            else {
+                optimizeVertexCache(chunkIndices.data() + ranges[r].firstIndex, ranges[r].indexCount, VERTEX_CACHE_SIZE);
+            }
+        }
+    });
+    auto optimizeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+    std::cout << "Vertex cache ACMR (" << VERTEX_CACHE_SIZE << " entries, FIFO/LRU): "
+        << fifoBefore << "/" << lruBefore << " before, "
+        << measure(VertexCacheModel::Fifo) << "/" << measure(VertexCacheModel::Lru)
+        << " after reordering in " << optimizeTime.count() << " ms" << std::endl;
+}
+
+void Terrain::calculateNormals() {
+    // Central differences on the height grid; the index buffer is not needed
+    const int width = terrainWidth;
+    const int height = terrainHeight;
+
+    forEachRowBand(height, [&](int zBegin, int zEnd) {
+        std::vector<float> normalX(width), normalY(width), normalZ(width);
+        for (int z = zBegin; z < zEnd; ++z) {
+            computeGridNormalRow(heightGrid.data(), width, height, TERRAIN_SCALE, z,
+                normalX.data(), normalY.data(), normalZ.data());
+
+            Vertex* row = vertices->data() + static_cast<size_t>(z) * width;
+            for (int x = 0; x < width; ++x) {
+                row[x].normal = glm::vec3(normalX[x], normalY[x], normalZ[x]);
+            }
+        }
+    });
+}
+
+void Terrain::packVertices() {
+    // Grid coordinates are exact in 16 bits; heights are spread over the
+    // [minHeight, maxHeight] range, see the positionScale uniform in draw()
+    const int width = terrainWidth;
+    const int height = terrainHeight;
+    const float range = maxHeight - minHeight;
+    const float toHeight = range > 0.0f ? 65535.0f / range : 0.0f;
+    packedVertices.resize(vertices->size());
+
+    forEachRowBand(height, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; ++z) {
+            for (int x = 0; x < width; ++x) {
+                const Vertex& vertex = (*vertices)[static_cast<size_t>(z) * width + x];
+                PackedVertex& packed = packedVertices[static_cast<size_t>(z) * width + x];
+                packed.position[0] = static_cast<GLushort>(x);
+                packed.position[1] = static_cast<GLushort>((vertex.position.y - minHeight) * toHeight + 0.5f);
+                packed.position[2] = static_cast<GLushort>(z);
+                encodeOctahedral(vertex.normal, packed.normal);
+                packed.texCoords[0] = static_cast<GLushort>(vertex.texCoords.x * 65535.0f + 0.5f);
+                packed.texCoords[1] = static_cast<GLushort>(vertex.texCoords.y * 65535.0f + 0.5f);
+            }
+        }
+    });
+}
+
+void Terrain::stageMeshBuffers() {
+    // The buffers exactly as the GPU gets them; the chunk layouts first
+    // gather each chunk's vertices together
+    const bool chunkLayout = settings.indexLayout != TerrainIndexLayout::Triangles;
+    if (settings.vertexFormat == TerrainVertexFormat::Packed) {
+        if (chunkLayout) {
+            auto gathered = std::make_shared<std::vector<PackedVertex>>(gatherChunkVertices(packedVertices, terrainWidth, chunks));
+            vertexUpload = { gathered, reinterpret_cast<const unsigned char*>(gathered->data()), gathered->size() * sizeof(PackedVertex) };
+        }
+        else {
+            vertexUpload = { nullptr, reinterpret_cast<const unsigned char*>(packedVertices.data()), packedVertices.size() * sizeof(PackedVertex) };
+        }
+    }
+    else {
+        if (chunkLayout) {
+            auto gathered = std::make_shared<std::vector<Vertex>>(gatherChunkVertices(*vertices, terrainWidth, chunks));
+            vertexUpload = { gathered, reinterpret_cast<const unsigned char*>(gathered->data()), gathered->size() * sizeof(Vertex) };
+        }
+        else {
+            vertexUpload = { nullptr, reinterpret_cast<const unsigned char*>(vertices->data()), vertices->size() * sizeof(Vertex) };
+        }
+    }
+
+    if (chunkLayout) {
+        indexUpload = { nullptr, reinterpret_cast<const unsigned char*>(chunkIndices.data()), chunkIndices.size() * sizeof(GLushort) };
+    }
+    else {
+        indexUpload = { nullptr, reinterpret_cast<const unsigned char*>(indices->data()), indices->size() * sizeof(unsigned int) };
+    }
+
+    if (!meshCacheFile.empty()) {
+        saveMeshCache(vertexUpload.data, vertexUpload.bytes, indexUpload.data, indexUpload.bytes);
     }
 }
 
-void Terrain::setupBuffers() {
+void Terrain::createMeshBuffers(size_t vertexBytes, size_t indexBytes) {
+    meshBufferBytes = vertexBytes + indexBytes;
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
     glBindVertexArray(VAO);
 
+    // Storage only; uploadStep fills it in slices
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vertex), vertices->data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices->size() * sizeof(unsigned int), indices->data(), GL_STATIC_DRAW);
+    if (settings.vertexFormat == TerrainVertexFormat::Packed) {
+        // Position attribute, scaled and offset in the vertex shader
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+        glEnableVertexAttribArray(0);
+
+        // Octahedral normal attribute, decoded in the vertex shader
+        glVertexAttribPointer(1, 2, GL_BYTE, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+        glEnableVertexAttribArray(1);
 
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
+        // Texture coords attribute
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+        glEnableVertexAttribArray(2);
+    }
+    else {
+        // Position attribute
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+        glEnableVertexAttribArray(0);
 
-    // Normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
+        // Normal attribute
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+        glEnableVertexAttribArray(1);
 
-    // Texture coords attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-    glEnableVertexAttribArray(2);
+        // Texture coords attribute
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+        glEnableVertexAttribArray(2);
+    }
 
     glBindVertexArray(0);
 }
 
 void Terrain::draw(const glm::mat4& view, const glm::mat4& projection) {
+    if (!isReady()) return;
+
+    Frustum frustum = Frustum::fromMatrix(projection * view);
+
     shader->use();
+    shader->setMat4("model", glm::mat4(1.0f));
     shader->setMat4("view", view);
     shader->setMat4("projection", projection);
+    shader->setBool("gridPatchEnabled", settings.renderMode != TerrainRenderMode::Mesh);
+    shader->setBool("streamingEnabled", settings.renderMode == TerrainRenderMode::Streaming);
+
+    bool packed = settings.renderMode == TerrainRenderMode::Mesh && settings.vertexFormat == TerrainVertexFormat::Packed;
+    shader->setBool("packedVertices", packed);
+    if (packed) {
+        // Inverse of packVertices: grid coordinates to world, 16-bit height to metres
+        shader->setVec3("positionScale", glm::vec3(TERRAIN_SCALE, (maxHeight - minHeight) / 65535.0f, TERRAIN_SCALE));
+        shader->setVec3("positionOffset", glm::vec3(-(terrainWidth / 2) * TERRAIN_SCALE, minHeight,
+            -(terrainHeight / 2) * TERRAIN_SCALE));
+    }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, terrainTexture);
+    // Samplers of different types must not share a unit, used or not
     shader->setInt("terrainTexture", 0);
+    shader->setInt("heightmap", 1);
+    shader->setInt("heightTiles", 2);
+    shader->setInt("splatMap", 3);
+    shader->setInt("materials", 4);
+    shader->setInt("occlusionMap", 5);
+
+    shader->setVec2("gridSize", glm::vec2(static_cast<float>(terrainWidth), static_cast<float>(terrainHeight)));
+    shader->setBool("occlusionEnabled", occlusionTexture != 0);
+    if (occlusionTexture) {
+        glActiveTexture(GL_TEXTURE5);
+        glBindTexture(GL_TEXTURE_2D, occlusionTexture);
+    }
+
+    shader->setBool("splatEnabled", !settings.materials.empty());
+    if (settings.materials.empty()) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, terrainTexture);
+    }
+    else {
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, splatTexture);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, materialTexture);
+        glm::vec2 gridSize(static_cast<float>(terrainWidth), static_cast<float>(terrainHeight));
+        shader->setInt("materialCount", static_cast<int>(settings.materials.size()));
+        shader->setVec2("materialScale", gridSize / static_cast<float>(std::max(settings.materialRepeatSamples, 1)));
+    }
+
+    if (settings.renderMode == TerrainRenderMode::Mesh) {
+        cullChunks(frustum);
+        if (drawCounts.empty()) return;
+
+        glBindVertexArray(VAO);
+        if (settings.indexLayout == TerrainIndexLayout::Triangles) {
+            glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT,
+                drawOffsets.data(), static_cast<GLsizei>(drawCounts.size()));
+        }
+        else if (settings.indexLayout == TerrainIndexLayout::ChunkTriangles) {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_SHORT,
+                drawOffsets.data(), static_cast<GLsizei>(drawCounts.size()), drawBaseVertices.data());
+        }
+        else {
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(PRIMITIVE_RESTART_INDEX);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLE_STRIP, drawCounts.data(), GL_UNSIGNED_SHORT,
+                drawOffsets.data(), static_cast<GLsizei>(drawCounts.size()), drawBaseVertices.data());
+            glDisable(GL_PRIMITIVE_RESTART);
+        }
+        glBindVertexArray(0);
+        return;
+    }
+
+    // The camera sits at the translation of the inverse view matrix
+    glm::vec3 cameraPosition(glm::inverse(view)[3]);
+    shader->setVec3("cameraPosition", cameraPosition);
+    shader->setVec2("heightmapSize", glm::vec2(static_cast<float>(terrainWidth), static_cast<float>(terrainHeight)));
+    shader->setVec2("gridCenter", glm::vec2(static_cast<float>(terrainWidth / 2), static_cast<float>(terrainHeight / 2)));
+    shader->setVec2("heightRange", glm::vec2(minHeight, maxHeight - minHeight));
+    shader->setFloat("terrainScale", TERRAIN_SCALE);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, heightmapTexture);
+
+    if (settings.renderMode == TerrainRenderMode::Streaming) {
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tileTexture);
+        shader->setFloat("tileSamples", static_cast<float>(pyramid->getTileSamples()));
+        shader->setVec2Array("morphConsts", lodMorphConsts.data(),
+            std::min(static_cast<int>(lodMorphConsts.size()), MAX_LOD_LEVELS));
+        drawStreaming(frustum, cameraPosition);
+    }
+    else if (settings.renderMode == TerrainRenderMode::Cdlod) {
+        shader->setVec2Array("morphConsts", lodMorphConsts.data(),
+            std::min(static_cast<int>(lodMorphConsts.size()), MAX_LOD_LEVELS));
+        drawLod(frustum, cameraPosition);
+    }
+    else {
+        // Never morph: the patch is drawn at full resolution
+        glm::vec2 noMorph(1.0f, 0.0f);
+        shader->setVec2Array("morphConsts", &noMorph, 1);
+        cullChunks(frustum);
+        drawPatchInstances(0, 4, 0, patchInstances.size());
+    }
+}
+
+void Terrain::cullChunks(const Frustum& frustum) {
+    drawCounts.clear();
+    drawOffsets.clear();
+    drawBaseVertices.clear();
+    patchInstances.clear();
+    visibleChunkCount = 0;
+    submittedTriangleCount = 0;
+
+    for (const auto& chunk : chunks) {
+        if (!frustum.intersectsAABB(chunk.boundsMin, chunk.boundsMax)) continue;
+
+        ++visibleChunkCount;
+
+        // Without a mesh every visible chunk is one instance of the patch
+        if (settings.renderMode != TerrainRenderMode::Mesh) {
+            submittedTriangleCount += patchQuadrantOffsets[4] / 3;
+            patchInstances.push_back({ chunk.x0, chunk.z0, 0, 0 });
+            continue;
+        }
+        submittedTriangleCount += settings.indexLayout == TerrainIndexLayout::ChunkStrips
+            ? static_cast<size_t>(chunk.quadsX) * chunk.quadsZ * 2 : chunk.indexCount / 3;
+
+        // Shared index ranges are drawn once per chunk at its base vertex
+        if (settings.indexLayout != TerrainIndexLayout::Triangles) {
+            drawCounts.push_back(static_cast<GLsizei>(chunk.indexCount));
+            drawOffsets.push_back(reinterpret_cast<const void*>(static_cast<size_t>(chunk.firstIndex) * sizeof(GLushort)));
+            drawBaseVertices.push_back(chunk.baseVertex);
+            continue;
+        }
+
+        // Chunks are stored in order, so neighbours merge into one range
+        const void* offset = reinterpret_cast<const void*>(static_cast<size_t>(chunk.firstIndex) * sizeof(unsigned int));
+        if (!drawCounts.empty() &&
+            static_cast<const char*>(drawOffsets.back()) + drawCounts.back() * sizeof(unsigned int) == offset) {
+            drawCounts.back() += static_cast<GLsizei>(chunk.indexCount);
+        }
+        else {
+            drawCounts.push_back(static_cast<GLsizei>(chunk.indexCount));
+            drawOffsets.push_back(offset);
+        }
+    }
+}
+
+void Terrain::buildLodQuadtree() {
+    quadtree.build(heightGrid, terrainWidth, terrainHeight, settings.lodPatchSize, TERRAIN_SCALE, MAX_LOD_LEVELS);
+    computeLodRanges(quadtree.getLevelCount());
+
+    std::cout << "Terrain LOD quadtree: " << quadtree.getLevelCount() << " levels of "
+        << quadtree.getPatchSize() << "x" << quadtree.getPatchSize() << " quad patches" << std::endl;
+}
+
+void Terrain::computeLodRanges(int levelCount) {
+    // Each level reaches twice as far as the one below it. Vertices start
+    // morphing towards the next level lodMorphStart of the way through their
+    // band and are fully morphed at its far end, where the next level takes
+    // over, so the switch itself is invisible.
+    lodRanges.resize(levelCount);
+    lodMorphConsts.resize(levelCount);
+    float previousRange = 0.0f;
+    for (int level = 0; level < levelCount; ++level) {
+        lodRanges[level] = settings.lodDetailRange * static_cast<float>(1 << level);
+        float morphEnd = lodRanges[level];
+        float morphStart = previousRange + (morphEnd - previousRange) * settings.lodMorphStart;
+        lodMorphConsts[level] = glm::vec2(morphEnd / (morphEnd - morphStart), 1.0f / (morphEnd - morphStart));
+        previousRange = lodRanges[level];
+    }
+}
+
+void Terrain::stageHeightmapTexels() {
+    // Heights are stored normalized to [minHeight, maxHeight] in 16 bits.
+    // The trail levelling pushes the range well past what 8 bits can hold.
+    auto texels = std::make_shared<std::vector<GLushort>>(heightGrid.size());
+    const float range = maxHeight - minHeight;
+    const float toTexel = range > 0.0f ? 65535.0f / range : 0.0f;
+    for (size_t i = 0; i < heightGrid.size(); ++i) {
+        (*texels)[i] = static_cast<GLushort>((heightGrid[i] - minHeight) * toTexel + 0.5f);
+    }
+    heightTexelUpload = { texels, reinterpret_cast<const unsigned char*>(texels->data()), texels->size() * sizeof(GLushort) };
+}
+
+void Terrain::createHeightmapTexture() {
+    if (!heightmapTexture) {
+        glGenTextures(1, &heightmapTexture);
+    }
+    glBindTexture(GL_TEXTURE_2D, heightmapTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, terrainWidth, terrainHeight, 0, GL_RED, GL_UNSIGNED_SHORT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void Terrain::uploadHeightmapTexture() {
+    stageHeightmapTexels();
+    createHeightmapTexture();
+    glBindTexture(GL_TEXTURE_2D, heightmapTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, terrainWidth, terrainHeight, GL_RED, GL_UNSIGNED_SHORT, heightTexelUpload.data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    heightTexelUpload = UploadSource();
+}
+
+void Terrain::createMaterialTexture() {
+    glGenTextures(1, &materialTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, materialTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, materialWidth, materialHeight,
+        static_cast<GLsizei>(settings.materials.size()), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void Terrain::createSplatTexture() {
+    if (!splatTexture) {
+        glGenTextures(1, &splatTexture);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, splatTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, terrainWidth, terrainHeight, getSplatLayerCount(), 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void Terrain::createOcclusionTexture() {
+    glGenTextures(1, &occlusionTexture);
+    glBindTexture(GL_TEXTURE_2D, occlusionTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, terrainWidth, terrainHeight, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void Terrain::uploadOcclusionRows(size_t offset, size_t bytes) {
+    const size_t rowBytes = static_cast<size_t>(terrainWidth);
+    glBindTexture(GL_TEXTURE_2D, occlusionTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(offset / rowBytes), terrainWidth,
+        static_cast<GLsizei>(bytes / rowBytes), GL_RED, GL_UNSIGNED_BYTE, occlusionUpload.data + offset);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Terrain::setupPatchBuffers(int patchSize) {
+    // One flat patch of patchSize x patchSize quads shared by every chunk or
+    // node, as 16-bit grid coordinates. Indices are grouped by quadrant so a
+    // CDLOD node can draw any subset of its quarters.
+    const int half = patchSize / 2;
+    std::vector<GLushort> patchVertices;
+    patchVertices.reserve(static_cast<size_t>(patchSize + 1) * (patchSize + 1) * 2);
+    for (int z = 0; z <= patchSize; ++z) {
+        for (int x = 0; x <= patchSize; ++x) {
+            patchVertices.push_back(static_cast<GLushort>(x));
+            patchVertices.push_back(static_cast<GLushort>(z));
+        }
+    }
+
+    std::vector<GLushort> patchIndices;
+    patchIndices.reserve(static_cast<size_t>(patchSize) * patchSize * 6);
+    for (int quadrant = 0; quadrant < 4; ++quadrant) {
+        int qx0 = (quadrant % 2) * half;
+        int qz0 = (quadrant / 2) * half;
+        int qx1 = quadrant % 2 ? patchSize : half;
+        int qz1 = quadrant / 2 ? patchSize : half;
+        for (int z = qz0; z < qz1; ++z) {
+            for (int x = qx0; x < qx1; ++x) {
+                GLushort topLeft = static_cast<GLushort>(z * (patchSize + 1) + x);
+                GLushort topRight = topLeft + 1;
+                GLushort bottomLeft = static_cast<GLushort>((z + 1) * (patchSize + 1) + x);
+                GLushort bottomRight = bottomLeft + 1;
+
+                patchIndices.push_back(topLeft);
+                patchIndices.push_back(bottomLeft);
+                patchIndices.push_back(topRight);
+                patchIndices.push_back(topRight);
+                patchIndices.push_back(bottomLeft);
+                patchIndices.push_back(bottomRight);
+            }
+        }
+        patchQuadrantOffsets[quadrant + 1] = static_cast<unsigned int>(patchIndices.size());
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &instanceVBO);
 
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
+    meshBufferBytes = (patchVertices.size() + patchIndices.size()) * sizeof(GLushort);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, patchVertices.size() * sizeof(GLushort), patchVertices.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, patchIndices.size() * sizeof(GLushort), patchIndices.data(), GL_STATIC_DRAW);
+
+    // Patch coordinate attribute
+    glVertexAttribIPointer(3, 2, GL_UNSIGNED_SHORT, 2 * sizeof(GLushort), (void*)0);
+    glEnableVertexAttribArray(3);
+
+    // Per-instance grid origin and level; the pointer is set per draw
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+
     glBindVertexArray(0);
 }
 
+void Terrain::drawPatchInstances(int firstQuadrant, int quadrantCount, size_t firstInstance, size_t instanceCount) {
+    if (instanceCount == 0) return;
+
+    // Upload the whole instance list once per frame, orphaning last frame's
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (firstInstance == 0) {
+        glBufferData(GL_ARRAY_BUFFER, patchInstances.size() * sizeof(PatchInstance), patchInstances.data(), GL_STREAM_DRAW);
+    }
+    glVertexAttribIPointer(4, 4, GL_INT, sizeof(PatchInstance), (void*)(firstInstance * sizeof(PatchInstance)));
+
+    unsigned int first = patchQuadrantOffsets[firstQuadrant];
+    unsigned int count = patchQuadrantOffsets[firstQuadrant + quadrantCount] - first;
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(count), GL_UNSIGNED_SHORT,
+        (void*)(static_cast<size_t>(first) * sizeof(GLushort)), static_cast<GLsizei>(instanceCount));
+    glBindVertexArray(0);
+}
+
+void Terrain::drawLod(const Frustum& frustum, const glm::vec3& cameraPosition) {
+    quadtree.select(frustum, cameraPosition, lodRanges, lodSelection);
+    drawSelection();
+}
+
+void Terrain::drawSelection() {
+    visibleChunkCount = lodSelection.size();
+    submittedTriangleCount = 0;
+
+    // Whole nodes come first, then nodes drawing a single quadrant grouped
+    // by quadrant, so the frame takes at most five instanced draws
+    patchInstances.clear();
+    size_t groupStart[6] = {};
+    for (int group = 0; group < 5; ++group) {
+        groupStart[group] = patchInstances.size();
+        for (const auto& node : lodSelection) {
+            if (group == 0 ? node.quadrants != 0xF : (node.quadrants == 0xF || !(node.quadrants & (1u << (group - 1))))) {
+                continue;
+            }
+            patchInstances.push_back({ node.gridX, node.gridZ, node.level, node.layer });
+        }
+    }
+    groupStart[5] = patchInstances.size();
+
+    for (int group = 0; group < 5; ++group) {
+        size_t count = groupStart[group + 1] - groupStart[group];
+        int firstQuadrant = group == 0 ? 0 : group - 1;
+        int quadrantCount = group == 0 ? 4 : 1;
+        drawPatchInstances(firstQuadrant, quadrantCount, groupStart[group], count);
+        submittedTriangleCount += count * (patchQuadrantOffsets[firstQuadrant + quadrantCount] - patchQuadrantOffsets[firstQuadrant]) / 3;
+    }
+}
+
+bool Terrain::openHeightPyramid(const std::string& pyramidPath) {
+    pyramid = std::make_unique<HeightPyramid>();
+    if (!pyramid->open(pyramidPath)) {
+        return false;
+    }
+
+    // Tiles are drawn with the shared patch, whose quadrants must line up
+    // with the child tiles
+    const int tileSize = pyramid->getTileSize();
+    if (tileSize % 2 != 0) {
+        std::cerr << "Streaming needs an even pyramid tile size, " << pyramidPath
+            << " has " << tileSize << std::endl;
+        return false;
+    }
+
+    terrainWidth = pyramid->getWidth();
+    terrainHeight = pyramid->getHeight();
+    minHeight = pyramid->getMinHeight();
+    maxHeight = pyramid->getMaxHeight();
+    if (pyramid->getLevelCount() > MAX_LOD_LEVELS) {
+        std::cerr << "Streaming supports " << MAX_LOD_LEVELS << " pyramid levels, " << pyramidPath
+            << " has " << pyramid->getLevelCount() << std::endl;
+        return false;
+    }
+    computeLodRanges(pyramid->getLevelCount());
+    return true;
+}
+
+void Terrain::setupTileTexture() {
+    // As many layers as the budget allows, enough for a tile and its children
+    const int samples = pyramid->getTileSamples();
+    const size_t tileBytes = static_cast<size_t>(samples) * samples * sizeof(float);
+    GLint maxLayers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    size_t budgetTiles = static_cast<size_t>(std::max(settings.streamingBudgetMB, 1)) * 1024 * 1024 / tileBytes;
+    int slotCount = static_cast<int>(std::min<size_t>(std::max<size_t>(budgetTiles, 5), static_cast<size_t>(std::max(maxLayers, 5))));
+
+    const int tileSize = pyramid->getTileSize();
+    glGenTextures(1, &tileTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, tileTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, samples, samples, slotCount, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    tileSlots.assign(slotCount, TileSlot{});
+    residentTiles.clear();
+    frameIndex = 0;
+
+    // The coarsest level stays resident as the fallback for everything else
+    const int top = pyramid->getLevelCount() - 1;
+    for (int tz = 0; tz < pyramid->getTilesZ(top); ++tz) {
+        for (int tx = 0; tx < pyramid->getTilesX(top); ++tx) {
+            loadTile(top, tx, tz, true);
+        }
+    }
+
+    std::cout << "Streaming terrain: " << terrainWidth << "x" << terrainHeight << ", "
+        << pyramid->getLevelCount() << " levels, " << slotCount << " tile slots of " << tileSize << "x" << tileSize
+        << " quads (" << slotCount * tileBytes / (1024 * 1024) << " MB)" << std::endl;
+}
+
+void Terrain::tileBounds(int level, int tileX, int tileZ, glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+    const int size = pyramid->getTileSize() << level;
+    const glm::vec2 range = pyramid->getTileRange(level, tileX, tileZ);
+
+    // Clipped to the grid, as in TerrainQuadtree::nodeBounds
+    int x0 = tileX * size;
+    int z0 = tileZ * size;
+    int x1 = std::min(x0 + size, terrainWidth - 1);
+    int z1 = std::min(z0 + size, terrainHeight - 1);
+    boundsMin = glm::vec3((x0 - terrainWidth / 2) * TERRAIN_SCALE, range.x, (z0 - terrainHeight / 2) * TERRAIN_SCALE);
+    boundsMax = glm::vec3((x1 - terrainWidth / 2) * TERRAIN_SCALE, range.y, (z1 - terrainHeight / 2) * TERRAIN_SCALE);
+}
+
+bool Terrain::selectTile(int level, int tileX, int tileZ, const Frustum& frustum, const glm::vec3& cameraPosition) {
+    glm::vec3 boundsMin, boundsMax;
+    tileBounds(level, tileX, tileZ, boundsMin, boundsMax);
+
+    // The rules of TerrainQuadtree::selectNode, except that a tile that is
+    // not on the GPU yet is requested and its parent covers the area
+    if (!sphereIntersectsAABB(cameraPosition, lodRanges[level], boundsMin, boundsMax)) {
+        return false;
+    }
+    if (!frustum.intersectsAABB(boundsMin, boundsMax)) {
+        return true;
+    }
+
+    auto resident = residentTiles.find(tileKey(level, tileX, tileZ));
+    if (resident == residentTiles.end()) {
+        tileRequests.emplace_back(level, tileX, tileZ);
+        return false;
+    }
+    tileSlots[resident->second].lastUsed = frameIndex;
+
+    const int size = pyramid->getTileSize() << level;
+    LodSelection node{ tileX * size, tileZ * size, level, 0xF, resident->second };
+    if (level == 0 || !sphereIntersectsAABB(cameraPosition, lodRanges[level - 1], boundsMin, boundsMax)) {
+        lodSelection.push_back(node);
+        return true;
+    }
+
+    node.quadrants = 0;
+    for (int dz = 0; dz < 2; ++dz) {
+        for (int dx = 0; dx < 2; ++dx) {
+            int childX = tileX * 2 + dx;
+            int childZ = tileZ * 2 + dz;
+            if (childX >= pyramid->getTilesX(level - 1) || childZ >= pyramid->getTilesZ(level - 1)) continue;
+            if (!selectTile(level - 1, childX, childZ, frustum, cameraPosition)) {
+                node.quadrants |= 1u << (dz * 2 + dx);
+            }
+        }
+    }
+    if (node.quadrants) {
+        lodSelection.push_back(node);
+    }
+    return true;
+}
+
+bool Terrain::loadTile(int level, int tileX, int tileZ, bool pinned) {
+    // A free slot, else the least recently drawn tile not needed this frame
+    int slot = -1;
+    for (int i = 0; i < static_cast<int>(tileSlots.size()); ++i) {
+        const TileSlot& candidate = tileSlots[i];
+        if (candidate.level < 0) {
+            slot = i;
+            break;
+        }
+        if (candidate.pinned || candidate.lastUsed == frameIndex) continue;
+        if (slot < 0 || candidate.lastUsed < tileSlots[slot].lastUsed) {
+            slot = i;
+        }
+    }
+    if (slot < 0) return false;
+
+    TileSlot& target = tileSlots[slot];
+    if (target.level >= 0) {
+        residentTiles.erase(tileKey(target.level, target.tileX, target.tileZ));
+    }
+
+    // Straight from the mapping; the OS reads the tile in on first touch
+    const int samples = pyramid->getTileSamples();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, tileTexture);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot, samples, samples, 1, GL_RED, GL_FLOAT,
+        pyramid->getTileData(level, tileX, tileZ));
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    target = TileSlot{ level, tileX, tileZ, frameIndex, pinned };
+    residentTiles[tileKey(level, tileX, tileZ)] = slot;
+    return true;
+}
+
+void Terrain::drawStreaming(const Frustum& frustum, const glm::vec3& cameraPosition) {
+    ++frameIndex;
+    lodSelection.clear();
+    tileRequests.clear();
+
+    const int top = pyramid->getLevelCount() - 1;
+    for (int tz = 0; tz < pyramid->getTilesZ(top); ++tz) {
+        for (int tx = 0; tx < pyramid->getTilesX(top); ++tx) {
+            if (selectTile(top, tx, tz, frustum, cameraPosition)) continue;
+
+            // Beyond even the coarsest range: still draw it at the coarsest level
+            glm::vec3 boundsMin, boundsMax;
+            tileBounds(top, tx, tz, boundsMin, boundsMax);
+            auto resident = residentTiles.find(tileKey(top, tx, tz));
+            if (resident != residentTiles.end() && frustum.intersectsAABB(boundsMin, boundsMax)) {
+                tileSlots[resident->second].lastUsed = frameIndex;
+                int size = pyramid->getTileSize() << top;
+                lodSelection.push_back({ tx * size, tz * size, top, 0xF, resident->second });
+            }
+        }
+    }
+    drawSelection();
+
+    // Coarse tiles first, since nothing finer can be drawn without them, then
+    // the nearest. Uploads are capped to keep the frame time steady.
+    auto tileDistance = [&](const glm::ivec3& tile) {
+        float size = static_cast<float>(pyramid->getTileSize() << tile.x);
+        glm::vec2 center(((tile.y + 0.5f) * size - terrainWidth / 2) * TERRAIN_SCALE,
+            ((tile.z + 0.5f) * size - terrainHeight / 2) * TERRAIN_SCALE);
+        return glm::length(center - glm::vec2(cameraPosition.x, cameraPosition.z));
+    };
+    std::sort(tileRequests.begin(), tileRequests.end(), [&](const glm::ivec3& a, const glm::ivec3& b) {
+        if (a.x != b.x) return a.x > b.x;
+        return tileDistance(a) < tileDistance(b);
+    });
+    int uploads = 0;
+    for (const auto& request : tileRequests) {
+        if (uploads >= settings.streamingUploadsPerFrame) break;
+
+        // Fails only when every slot was drawn this frame: the budget is full
+        if (!loadTile(request.x, request.y, request.z, false)) break;
+        ++uploads;
+    }
+}
+
+float Terrain::heightAt(float x, float z) const {
+    // Inverse of the grid placement in generateTerrainVertices, rounded the
+    // same way as in heightsAt
+    float gridX = x * (1.0f / TERRAIN_SCALE) + static_cast<float>(terrainWidth / 2);
+    float gridZ = z * (1.0f / TERRAIN_SCALE) + static_cast<float>(terrainHeight / 2);
+    if (pyramid) {
+        return pyramid->sampleHeight(gridX, gridZ);
+    }
+    if (terrainWidth < 2 || terrainHeight < 2) {
+        return 0.0f;
+    }
+    return sampleGridHeight(heightGrid.data(), terrainWidth, terrainHeight, gridX, gridZ);
+}
+
+void Terrain::heightsAt(const glm::vec2* positions, float* heights, size_t count) const {
+    if (pyramid || terrainWidth < 2 || terrainHeight < 2) {
+        for (size_t i = 0; i < count; ++i) {
+            heights[i] = heightAt(positions[i].x, positions[i].y);
+        }
+        return;
+    }
+    glm::vec2 gridOffset(static_cast<float>(terrainWidth / 2), static_cast<float>(terrainHeight / 2));
+    sampleGridHeights(heightGrid.data(), terrainWidth, terrainHeight, 1.0f / TERRAIN_SCALE, gridOffset,
+        positions, heights, count);
+}
+
+TerrainRayHit Terrain::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+    return raycaster.raycast(origin, direction, maxDistance);
+}
+
+void Terrain::raycast(const glm::vec3* origins, const glm::vec3* directions, TerrainRayHit* hits, size_t count,
+    float maxDistance, ThreadPool* pool) const {
+    raycaster.raycast(origins, directions, hits, count, maxDistance, pool);
+}
+
+bool Terrain::exportHeightPyramid(const std::string& path, int tileSize) const {
+    if (heightGrid.empty()) {
+        std::cerr << "No height grid to export as a pyramid" << std::endl;
+        return false;
+    }
+
+    const int width = terrainWidth;
+    const int height = terrainHeight;
+    return HeightPyramid::build(path, width, height, tileSize, [&](int x0, int z0, int step, int countX, int countZ, float* out) {
+        for (int z = 0; z < countZ; ++z) {
+            size_t row = static_cast<size_t>(std::min(std::max(z0 + z * step, 0), height - 1)) * width;
+            for (int x = 0; x < countX; ++x) {
+                *out++ = heightGrid[row + std::min(std::max(x0 + x * step, 0), width - 1)];
+            }
+        }
+    });
+}
+
 void Terrain::debugOutput() const {
     std::cout << "\nTerrain Debug Information:" << std::endl;
     std::cout << "Number of vertices: " << vertices->size() << std::endl;
-    std::cout << "Number of indices: " << indices->size() << std::endl;
+    if (!packedVertices.empty()) {
+        std::cout << "Vertex buffer: " << packedVertices.size() * sizeof(PackedVertex) / (1024 * 1024)
+            << " MB packed, " << vertices->size() * sizeof(Vertex) / (1024 * 1024) << " MB as floats" << std::endl;
+    }
+    if (settings.indexLayout == TerrainIndexLayout::Triangles) {
+        std::cout << "Number of indices: " << indices->size() << " ("
+            << indices->size() * sizeof(unsigned int) / 1024 << " KB)" << std::endl;
+    }
+    else {
+        std::cout << "Number of indices: " << chunkIndices.size() << " shared by all chunks ("
+            << chunkIndices.size() * sizeof(GLushort) / 1024 << " KB)" << std::endl;
+    }
     std::cout << "Min height: " << minHeight << std::endl;
     std::cout << "Max height: " << maxHeight << std::endl;
     std::cout << "Terrain dimensions: " << terrainWidth << "x" << terrainHeight << std::endl;
-
-    glm::vec3 minBounds(std::numeric_limits<float>::max());
-    glm::vec3 maxBounds(std::numeric_limits<float>::lowest());
-
-    for (const auto& vertex : *vertices) {
-        minBounds = glm::min(minBounds, vertex.position);
-        maxBounds = glm::max(maxBounds, vertex.position);
+    if (settings.renderMode == TerrainRenderMode::Streaming) {
+        std::cout << "Terrain LOD levels: " << pyramid->getLevelCount() << ", " << residentTiles.size()
+            << " of " << tileSlots.size() << " tile slots resident" << std::endl;
+    }
+    else if (settings.renderMode == TerrainRenderMode::Cdlod) {
+        std::cout << "Terrain LOD levels: " << quadtree.getLevelCount() << std::endl;
+    }
+    else {
+        std::cout << "Terrain chunks: " << chunks.size() << " of up to "
+            << settings.chunkSize << "x" << settings.chunkSize << " quads" << std::endl;
     }
 
+    // The grid is centred on the origin, see generateTerrainVertices
+    glm::vec3 minBounds((0 - terrainWidth / 2) * TERRAIN_SCALE, minHeight, (0 - terrainHeight / 2) * TERRAIN_SCALE);
+    glm::vec3 maxBounds((terrainWidth - 1 - terrainWidth / 2) * TERRAIN_SCALE, maxHeight,
+        (terrainHeight - 1 - terrainHeight / 2) * TERRAIN_SCALE);
+
     std::cout << "Terrain bounds:" << std::endl;
     std::cout << "X: " << minBounds.x << " to " << maxBounds.x << std::endl;
     std::cout << "Y: " << minBounds.y << " to " << maxBounds.y << std::endl;
     std::cout << "Z: " << minBounds.z << " to " << maxBounds.z << std::endl;
 }
 
+size_t Terrain::getGpuBytes() const {
+    size_t bytes = meshBufferBytes;
+    if (terrainTexture) {
+        // A full mip chain adds a third
+        size_t texelBytes = textureFormat == GL_RGBA ? 4 : 3;
+        bytes += static_cast<size_t>(textureWidth) * textureHeight * texelBytes * 4 / 3;
+    }
+    if (heightmapTexture) {
+        bytes += static_cast<size_t>(terrainWidth) * terrainHeight * sizeof(GLushort);
+    }
+    if (materialTexture) {
+        bytes += static_cast<size_t>(materialWidth) * materialHeight * 3 * settings.materials.size() * 4 / 3;
+    }
+    if (occlusionTexture) {
+        bytes += static_cast<size_t>(terrainWidth) * terrainHeight;
+    }
+    if (splatTexture) {
+        bytes += static_cast<size_t>(terrainWidth) * terrainHeight * 4 * getSplatLayerCount();
+    }
+    if (tileTexture) {
+        size_t samples = static_cast<size_t>(pyramid->getTileSamples());
+        bytes += tileSlots.size() * samples * samples * sizeof(float);
+    }
+    return bytes;
+}
+
 void Terrain::cleanup() {
     if (VAO) glDeleteVertexArrays(1, &VAO);
     if (VBO) glDeleteBuffers(1, &VBO);
     if (EBO) glDeleteBuffers(1, &EBO);
+    if (instanceVBO) glDeleteBuffers(1, &instanceVBO);
     if (heightmapTexture) glDeleteTextures(1, &heightmapTexture);
+    if (tileTexture) glDeleteTextures(1, &tileTexture);
     if (terrainTexture) glDeleteTextures(1, &terrainTexture);
+    if (materialTexture) glDeleteTextures(1, &materialTexture);
+    if (splatTexture) glDeleteTextures(1, &splatTexture);
+    if (occlusionTexture) glDeleteTextures(1, &occlusionTexture);
 }
\ No newline at end of file
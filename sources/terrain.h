@@ -1,10 +1,22 @@
 #pragma once
 #include <GL/glew.h>
 #include <string>
+#include <chrono>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <cstdint>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include "Shader.h"
+#include "terrain_quadtree.h"
+#include "terrain_raycast.h"
+#include "terrain_splat.h"
+
+class ThreadPool;
+struct Frustum;
+struct TerrainCacheData;
+class HeightPyramid;
 
 struct Vertex {
     glm::vec3 position;
@@ -12,6 +24,124 @@ struct Vertex {
     glm::vec2 texCoords;
 };
 
+// Packed alternative to Vertex, 12 bytes instead of 32. Positions are grid
+// coordinates plus a 16-bit height, decoded in the vertex shader with the
+// terrain's origin and scale; normals are octahedral-encoded in 2x8 bits
+// (0.33 degrees mean error, 0.93 max); texture coordinates are normalized.
+struct PackedVertex {
+    GLushort position[3];
+    GLbyte normal[2];
+    GLushort texCoords[2];
+};
+
+// Vertex buffer layout of the Mesh render mode
+enum class TerrainVertexFormat {
+    Float,  // Vertex
+    Packed  // PackedVertex
+};
+
+// Index buffer layout of the Mesh render mode
+enum class TerrainIndexLayout {
+    Triangles,      // One 32-bit triangle list over the whole grid
+    ChunkTriangles, // 16-bit triangle list per chunk size, shared by all chunks of that size
+    ChunkStrips     // As ChunkTriangles, one strip per quad row joined by primitive restart
+};
+
+// How the terrain is turned into triangles
+enum class TerrainRenderMode {
+    Mesh,           // Full-resolution CPU mesh, culled per chunk
+    GpuDisplaced,   // Full resolution, one shared patch per chunk displaced by the heightmap texture
+    Cdlod,          // Quadtree LOD: one shared patch, heights fetched in the vertex shader
+    Streaming       // Cdlod over a HeightPyramid file, tiles paged into the GPU on demand
+};
+
+// Options fixed at Terrain::initialize time
+struct TerrainSettings {
+    // Build vertices, indices and normals in row bands on a worker pool.
+    // The result is bit-for-bit identical to the serial build.
+    bool parallelMeshBuild{ true };
+    unsigned int workerThreads{ 0 };    // 0 = one per hardware thread
+
+    // Quads per side of a culling chunk (at most 255 in GpuDisplaced mode)
+    int chunkSize{ 64 };
+
+    TerrainRenderMode renderMode{ TerrainRenderMode::Mesh };
+    TerrainVertexFormat vertexFormat{ TerrainVertexFormat::Float };
+
+    // The chunk layouts store each chunk's vertices contiguously (border
+    // vertices are duplicated) so that every chunk can be drawn with the
+    // same 16-bit indices and a base vertex
+    TerrainIndexLayout indexLayout{ TerrainIndexLayout::Triangles };
+
+    // Reorder each chunk's triangles for post-transform vertex cache reuse
+    // and print the simulated ACMR before and after. Strips keep their order.
+    bool optimizeVertexCache{ false };
+
+    // Above 0, the Triangles layout replaces the regular grid with an
+    // adaptive RTIN mesh whose vertical error stays within this many metres.
+    // Flat areas get large triangles and steep ones keep full detail.
+    float simplifyMaxError{ 0.0f };
+
+    // Directory of the binary terrain cache; empty disables it. A cache file
+    // is keyed on the height map contents, the trail, the generation
+    // constants and these settings, and on a hit is mapped and uploaded as is.
+    std::string meshCacheDirectory;
+
+    // Quadtree LOD: quads per node side, distance drawn at full detail (each
+    // coarser level reaches twice as far), and the fraction of each level's
+    // distance band after which vertices morph towards the next level
+    int lodPatchSize{ 32 };
+    float lodDetailRange{ 4000.0f };
+    float lodMorphStart{ 0.7f };
+
+    // Streaming mode: the height map path names a HeightPyramid file. Tiles
+    // live in a texture array of at most streamingBudgetMB; the least
+    // recently drawn ones are evicted, and at most streamingUploadsPerFrame
+    // are uploaded per frame. Until a tile arrives its parent is drawn.
+    int streamingBudgetMB{ 256 };
+    int streamingUploadsPerFrame{ 8 };
+
+    // Up to MAX_TERRAIN_MATERIALS materials blended in one pass by a splat
+    // map of height and slope weights built with the terrain, instead of the
+    // single texture. Each repeats every materialRepeatSamples grid samples.
+    // Not available in Streaming mode, which never holds the whole grid.
+    std::vector<TerrainMaterial> materials;
+    int materialRepeatSamples{ 16 };
+
+    // Bake ambient occlusion from the height grid on the worker pool,
+    // searching the horizon in occlusionDirections directions out to
+    // occlusionRadius samples. Stored in the terrain cache with the mesh.
+    // Not available in Streaming mode, which never holds the whole grid.
+    bool bakeOcclusion{ true };
+    int occlusionDirections{ 16 };
+    int occlusionRadius{ 64 };
+};
+
+// Per-instance attribute of the shared patch: where to place it and at
+// which grid step (1 << level), and in Streaming mode the texture array
+// layer holding its heights
+struct PatchInstance {
+    GLint gridX;
+    GLint gridZ;
+    GLint level;
+    GLint layer;
+};
+
+// Square block of quads with its own index range and bounding box. With the
+// chunk index layouts the index range is the shared one for the chunk's size
+// and baseVertex locates the chunk's own vertices.
+struct TerrainChunk {
+    int x0{ 0 };                    // First quad column
+    int z0{ 0 };                    // First quad row
+    int quadsX{ 0 };
+    int quadsZ{ 0 };
+    unsigned int firstIndex{ 0 };
+    unsigned int indexCount{ 0 };
+    GLint baseVertex{ 0 };
+    glm::vec3 boundsMin{ 0.0f };
+    glm::vec3 boundsMax{ 0.0f };
+};
+
 class Terrain {
 public:
     Terrain();
@@ -21,23 +151,78 @@ public:
     Terrain(const Terrain&) = delete;
     Terrain& operator=(const Terrain&) = delete;
 
+    // prepare() followed by uploadStep() until the terrain is ready
     bool initialize(const std::string& heightMapPath,
         const std::string& texturePath,
-        const std::vector<glm::vec3>& hikingData);
+        const std::vector<glm::vec3>& hikingData,
+        const TerrainSettings& terrainSettings = TerrainSettings());
+
+    // Two-phase loading, see TerrainLoader. prepare() decodes, builds and
+    // stages everything without touching OpenGL, so it may run on a worker
+    // thread. uploadStep() must run on the GL thread: it creates the GL
+    // objects and uploads the staged data in slices, stopping once budgetMs
+    // has been spent (at most one slice late). Returns false on failure.
+    bool prepare(const std::string& heightMapPath,
+        const std::string& texturePath,
+        const std::vector<glm::vec3>& hikingData,
+        const TerrainSettings& terrainSettings = TerrainSettings());
+    bool uploadStep(double budgetMs);
+    bool isReady() const { return uploadStage == UploadStage::Ready; }
     void draw(const glm::mat4& view, const glm::mat4& projection);
     void debugOutput() const;
     void cleanup();
 
+    // Swap in another area without rebuilding any buffers: only the height
+    // texture is re-uploaded. GpuDisplaced and Cdlod modes only.
+    bool reloadHeightMap(const std::string& heightMapPath, const std::vector<glm::vec3>& hikingData);
+
     // Getters for terrain properties
     float getMinHeight() const { return minHeight; }
     float getMaxHeight() const { return maxHeight; }
     int getWidth() const { return terrainWidth; }
     int getHeight() const { return terrainHeight; }
 
+    // Ground height at world (x, z), bilinear between grid samples and
+    // clamped to the terrain's edge. Thread-safe once initialized.
+    float heightAt(float x, float z) const;
+    // heightAt for count world (x, z) positions at once, vectorized
+    void heightsAt(const glm::vec2* positions, float* heights, size_t count) const;
+
+    // First hit of a ray with the full-resolution terrain surface, for
+    // picking and line of sight. The batched form spreads the rays over
+    // the pool's workers when one is given. Not available in Streaming mode.
+    TerrainRayHit raycast(const glm::vec3& origin, const glm::vec3& direction,
+        float maxDistance = std::numeric_limits<float>::max()) const;
+    void raycast(const glm::vec3* origins, const glm::vec3* directions, TerrainRayHit* hits, size_t count,
+        float maxDistance = std::numeric_limits<float>::max(), ThreadPool* pool = nullptr) const;
+
+    // Culling results of the last draw call. In Cdlod mode the visible
+    // chunks are the selected quadtree nodes.
+    size_t getVisibleChunkCount() const { return visibleChunkCount; }
+    size_t getTotalChunkCount() const { return chunks.size(); }
+    size_t getSubmittedTriangleCount() const { return submittedTriangleCount; }
+
+    // Streaming mode: tiles on the GPU and the number that fit the budget
+    size_t getResidentTileCount() const { return residentTiles.size(); }
+    size_t getTileSlotCount() const { return tileSlots.size(); }
+
+    // Video memory held by the buffers and textures, mipmaps included;
+    // the per-frame instance buffer is left out
+    size_t getGpuBytes() const;
+
+    // Writes the loaded height grid (trail levelling included) as a
+    // HeightPyramid for the Streaming mode. Not available in Streaming mode
+    // itself, which never holds the whole grid.
+    bool exportHeightPyramid(const std::string& path, int tileSize = 128) const;
+
 private:
     // Mesh data
     std::unique_ptr<std::vector<Vertex>> vertices;
     std::unique_ptr<std::vector<unsigned int>> indices;
+    std::vector<PackedVertex> packedVertices;   // Only with TerrainVertexFormat::Packed
+    std::vector<GLushort> chunkIndices;         // Only with the chunk index layouts
+    std::vector<float> heightGrid;      // Final elevation per grid vertex, row-major, kept for height queries
+    TerrainRaycaster raycaster;         // Min/max pyramid over heightGrid
 
     // OpenGL objects
     GLuint VAO{ 0 };
@@ -45,7 +230,42 @@ private:
     GLuint EBO{ 0 };
     GLuint heightmapTexture{ 0 };
     GLuint terrainTexture{ 0 };
+    GLuint materialTexture{ 0 };        // RGB array, one layer per material
+    GLuint splatTexture{ 0 };           // RGBA8 array, four material weights per layer
+    GLuint occlusionTexture{ 0 };       // R8, visible sky per grid sample
     std::unique_ptr<Shader> shader;
+    size_t meshBufferBytes{ 0 };        // VBO + EBO, in either layout
+
+    // Only alive while the mesh is being built
+    TerrainSettings settings;
+    std::unique_ptr<ThreadPool> buildPool;
+
+    // Data waiting for the GPU, uploaded in slices by uploadStep. The owner
+    // keeps temporary or mapped data alive; Terrain's own arrays need none.
+    struct UploadSource {
+        std::shared_ptr<const void> owner;
+        const unsigned char* data{ nullptr };
+        size_t bytes{ 0 };
+        size_t uploaded{ 0 };
+    };
+    enum class UploadStage { Shader, Objects, Data, Finish, Ready };
+    UploadStage uploadStage{ UploadStage::Shader };
+    UploadSource vertexUpload;
+    UploadSource indexUpload;
+    UploadSource heightTexelUpload;     // R16 rows of heightmapTexture
+    UploadSource textureUpload;         // Rows of terrainTexture
+    UploadSource materialUpload;        // Rows of materialTexture, layer after layer
+    UploadSource splatUpload;           // Rows of splatTexture, layer after layer
+    UploadSource occlusionUpload;       // Rows of occlusionTexture
+    int textureWidth{ 0 };
+    int textureHeight{ 0 };
+    GLenum textureFormat{ GL_RGB };
+    int materialWidth{ 0 };
+    int materialHeight{ 0 };
+
+    // Cache file to write once the buffers are built, empty on a cache hit
+    std::string meshCacheFile;
+    uint64_t meshCacheKey{ 0 };
 
     // Terrain properties
     unsigned int numIndices{ 0 };
@@ -54,14 +274,100 @@ private:
     int terrainWidth{ 0 };
     int terrainHeight{ 0 };
 
+    // Chunks and the per-frame draw list of the visible ones
+    std::vector<TerrainChunk> chunks;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+    std::vector<GLint> drawBaseVertices;
+    size_t visibleChunkCount{ 0 };
+    size_t submittedTriangleCount{ 0 };
+
+    // GPU heightmap modes: VAO/VBO/EBO hold the shared patch, drawn once
+    // per PatchInstance. patchQuadrantOffsets[q] is the first index of
+    // quadrant q, [4] the total.
+    GLuint instanceVBO{ 0 };
+    std::vector<PatchInstance> patchInstances;
+    unsigned int patchQuadrantOffsets[5]{};
+
+    // Quadtree LOD state
+    TerrainQuadtree quadtree;
+    std::vector<float> lodRanges;
+    std::vector<glm::vec2> lodMorphConsts;
+    std::vector<LodSelection> lodSelection;
+
+    // Streaming state. Each slot is one layer of tileTexture; the coarsest
+    // tile is pinned so there is always something to draw.
+    struct TileSlot {
+        int level{ -1 };            // -1 = free
+        int tileX{ 0 };
+        int tileZ{ 0 };
+        unsigned int lastUsed{ 0 }; // Frame the tile was last selected
+        bool pinned{ false };
+    };
+    std::unique_ptr<HeightPyramid> pyramid;
+    GLuint tileTexture{ 0 };
+    std::vector<TileSlot> tileSlots;
+    std::unordered_map<uint64_t, int> residentTiles;    // Tile key to slot
+    std::vector<glm::ivec3> tileRequests;               // (level, x, z) missed this frame
+    unsigned int frameIndex{ 0 };
+
     // Private methods
+    bool buildTerrain(const std::string& heightMapPath, const std::vector<glm::vec3>& hikingData);
+    bool restoreFromCache(const TerrainCacheData& cached);
+    std::string meshCachePath(const std::string& heightMapPath, const std::vector<glm::vec3>& hikingData);
+    void saveMeshCache(const void* vertexData, size_t vertexBytes, const void* indexData, size_t indexBytes);
     bool loadHeightMap(const std::string& path, int& width, int& height,
         std::vector<unsigned char>& heightData);
-    bool loadTexture(const std::string& path);
-    void generateTerrainVertices(const std::vector<unsigned char>& heightData,
+    bool stageTexture(const DecodedImage& image);
+    bool stageMaterials(const std::vector<DecodedImage>& layers);
+    void stageSplatMap();
+    void bakeOcclusion();
+    int getSplatLayerCount() const { return (static_cast<int>(settings.materials.size()) + 3) / 4; }
+    void buildHeightGrid(const std::vector<unsigned char>& heightData,
         int width, int height,
         const std::vector<glm::vec3>& hikingData);
-    void generateTerrainIndices(int width, int height);
+    void generateTerrainVertices(int width, int height);
+    void flattenUnderTrail(int width, int height, const std::vector<glm::vec3>& hikingData);
+    void buildChunks(int width, int height);
+    void generateTerrainIndices(int width);
+    void generateChunkIndices();
+    void simplifyTerrain(int width, int height);
+    void compactVertices();
+    void optimizeIndexOrder();
+    // Normals come from central differences of heightGrid rather than from
+    // accumulating face normals. The two agree exactly on planar areas. On
+    // hoydedata_svarthvitt.png the deviation is 0.15 degrees mean, 1.1 p99 and
+    // 3.7 max. The exception is the step at the edge of the flattened trail,
+    // a near-vertical wall where neither estimate is meaningful.
     void calculateNormals();
-    void setupBuffers();
+    void packVertices();
+    void forEachRowBand(int rows, const std::function<void(int, int)>& fn);
+    void stageMeshBuffers();
+    void createMeshBuffers(size_t vertexBytes, size_t indexBytes);
+    void createGpuObjects();
+    void createMaterialTexture();
+    void createSplatTexture();
+    void createOcclusionTexture();
+    void uploadOcclusionRows(size_t offset, size_t bytes);
+    void uploadTextureArrayRows(GLuint texture, int width, int height, GLenum format, size_t texelBytes,
+        const UploadSource& source, size_t offset, size_t bytes);
+    bool uploadStagedData(std::chrono::steady_clock::time_point deadline);
+    bool drainUpload(UploadSource& source, size_t granularity, std::chrono::steady_clock::time_point deadline,
+        const std::function<void(size_t, size_t)>& upload);
+    void cullChunks(const Frustum& frustum);
+    void buildLodQuadtree();
+    void computeLodRanges(int levelCount);
+    void stageHeightmapTexels();
+    void createHeightmapTexture();
+    void uploadHeightmapTexture();
+    void setupPatchBuffers(int patchSize);
+    void drawPatchInstances(int firstQuadrant, int quadrantCount, size_t firstInstance, size_t instanceCount);
+    void drawLod(const Frustum& frustum, const glm::vec3& cameraPosition);
+    void drawSelection();
+    bool openHeightPyramid(const std::string& pyramidPath);
+    void setupTileTexture();
+    bool selectTile(int level, int tileX, int tileZ, const Frustum& frustum, const glm::vec3& cameraPosition);
+    void tileBounds(int level, int tileX, int tileZ, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+    bool loadTile(int level, int tileX, int tileZ, bool pinned);
+    void drawStreaming(const Frustum& frustum, const glm::vec3& cameraPosition);
 };
\ No newline at end of file
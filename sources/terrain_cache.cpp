@@ -0,0 +1,192 @@
+// terrain_cache.cpp
+#include "terrain_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr char CACHE_MAGIC[8] = { 'T', 'E', 'R', 'R', 'M', 'E', 'S', 'H' };
+
+    // Bump whenever the header, a section or TerrainChunk changes
+    constexpr uint32_t CACHE_VERSION = 2;
+
+    constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+    struct Section {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // Distinct per process and thread, as viewers may write the same cache
+    // at once and must not truncate each other's temporary file
+    std::string writerSuffix() {
+#ifdef _WIN32
+        const int processId = _getpid();
+#else
+        const int processId = static_cast<int>(getpid());
+#endif
+        return std::to_string(processId) + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    }
+
+    struct CacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t chunkStride;       // sizeof(TerrainChunk) of the writer
+        uint64_t key;
+        int32_t width;
+        int32_t height;
+        float minHeight;
+        float maxHeight;
+        uint32_t indexCount;
+        uint32_t reserved;
+        Section heights;
+        Section chunks;
+        Section vertices;
+        Section indices;
+        Section occlusion;
+    };
+
+    uint64_t alignUp(uint64_t value) {
+        return (value + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    }
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool TerrainCache::write(const std::string& path, uint64_t key, const TerrainCacheData& data) {
+    CacheHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.chunkStride = sizeof(TerrainChunk);
+    header.key = key;
+    header.width = data.width;
+    header.height = data.height;
+    header.minHeight = data.minHeight;
+    header.maxHeight = data.maxHeight;
+    header.indexCount = data.indexCount;
+
+    uint64_t offset = alignUp(sizeof(CacheHeader));
+    auto place = [&](Section& section, uint64_t size) {
+        section.offset = offset;
+        section.size = size;
+        offset = alignUp(offset + size);
+    };
+    place(header.heights, static_cast<uint64_t>(data.width) * data.height * sizeof(float));
+    place(header.chunks, data.chunkCount * sizeof(TerrainChunk));
+    place(header.vertices, data.vertexBytes);
+    place(header.indices, data.indexBytes);
+    place(header.occlusion, data.occlusionBytes);
+
+    std::string tempPath = path + "." + writerSuffix() + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to create terrain cache: " << tempPath << std::endl;
+            return false;
+        }
+
+        auto writeSection = [&](const Section& section, const void* bytes) {
+            static const char padding[SECTION_ALIGNMENT] = {};
+            out.seekp(0, std::ios::end);
+            uint64_t position = static_cast<uint64_t>(out.tellp());
+            out.write(padding, static_cast<std::streamsize>(section.offset - position));
+            if (section.size) {
+                out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(section.size));
+            }
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeSection(header.heights, data.heights);
+        writeSection(header.chunks, data.chunks);
+        writeSection(header.vertices, data.vertexData);
+        writeSection(header.indices, data.indexData);
+        writeSection(header.occlusion, data.occlusion);
+
+        if (!out) {
+            std::cerr << "Failed to write terrain cache: " << tempPath << std::endl;
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    // Another process may have written the same cache in the meantime; its
+    // file is identical, so replacing it is fine. While another viewer has
+    // it mapped Windows refuses both the remove and the rename.
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to rename terrain cache: " << tempPath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TerrainCache::open(const std::string& path, uint64_t key) {
+    close();
+    if (!file.open(path)) return false;
+
+    CacheHeader header;
+    if (file.size() < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != CACHE_VERSION || header.chunkStride != sizeof(TerrainChunk) || header.key != key ||
+        header.width < 2 || header.height < 2 ||
+        header.heights.size != static_cast<uint64_t>(header.width) * header.height * sizeof(float) ||
+        (header.occlusion.size != 0 && header.occlusion.size != static_cast<uint64_t>(header.width) * header.height)) {
+        std::cerr << "Ignoring stale terrain cache: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    for (const Section* section : { &header.heights, &header.chunks, &header.vertices, &header.indices, &header.occlusion }) {
+        if (section->offset + section->size > file.size()) {
+            std::cerr << "Ignoring truncated terrain cache: " << path << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    data.width = header.width;
+    data.height = header.height;
+    data.minHeight = header.minHeight;
+    data.maxHeight = header.maxHeight;
+    data.indexCount = header.indexCount;
+    data.heights = reinterpret_cast<const float*>(file.data() + header.heights.offset);
+    data.chunks = reinterpret_cast<const TerrainChunk*>(file.data() + header.chunks.offset);
+    data.chunkCount = static_cast<size_t>(header.chunks.size / sizeof(TerrainChunk));
+    data.vertexData = file.data() + header.vertices.offset;
+    data.vertexBytes = static_cast<size_t>(header.vertices.size);
+    data.indexData = file.data() + header.indices.offset;
+    data.indexBytes = static_cast<size_t>(header.indices.size);
+    if (header.occlusion.size) {
+        data.occlusion = file.data() + header.occlusion.offset;
+        data.occlusionBytes = static_cast<size_t>(header.occlusion.size);
+    }
+    return true;
+}
+
+void TerrainCache::close() {
+    file.close();
+    data = TerrainCacheData();
+}
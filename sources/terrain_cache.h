@@ -0,0 +1,49 @@
+// terrain_cache.h
+#pragma once
+#include <cstdint>
+#include <string>
+#include "terrain.h"
+#include "mapped_file.h"
+
+// 64-bit FNV-1a, chained through seed to hash several pieces of data
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+// Everything a warm start needs from a finished terrain build. When read
+// back, the pointers point into the mapped cache file.
+struct TerrainCacheData {
+    int width{ 0 };
+    int height{ 0 };
+    float minHeight{ 0.0f };
+    float maxHeight{ 0.0f };
+    const float* heights{ nullptr };            // width * height, row-major
+    const TerrainChunk* chunks{ nullptr };
+    size_t chunkCount{ 0 };
+    unsigned int indexCount{ 0 };
+    const void* vertexData{ nullptr };          // GPU vertex buffer as uploaded
+    size_t vertexBytes{ 0 };
+    const void* indexData{ nullptr };           // GPU index buffer as uploaded
+    size_t indexBytes{ 0 };
+    const unsigned char* occlusion{ nullptr };  // width * height baked occlusion, or none
+    size_t occlusionBytes{ 0 };
+};
+
+// Versioned binary cache of a terrain build, keyed on a hash of all its
+// inputs. The file is a fixed header followed by 16-byte aligned sections,
+// and is read through a memory mapping so nothing is parsed or copied
+// before the GPU upload.
+class TerrainCache {
+public:
+    // Writes to a temporary file and renames it, so concurrent readers
+    // never see a partial file
+    static bool write(const std::string& path, uint64_t key, const TerrainCacheData& data);
+
+    // Maps the file; fails on a missing file or a version or key mismatch
+    bool open(const std::string& path, uint64_t key);
+    void close();
+
+    const TerrainCacheData& getData() const { return data; }
+
+private:
+    MappedFile file;
+    TerrainCacheData data;
+};
@@ -0,0 +1,72 @@
+// terrain_loader.cpp
+#include "terrain_loader.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+TerrainLoader::~TerrainLoader() {
+    // The worker writes into the pending terrain
+    if (preparing.valid()) {
+        preparing.wait();
+    }
+}
+
+void TerrainLoader::cancel() {
+    if (preparing.valid()) {
+        preparing.wait();
+        preparing = std::future<bool>();
+    }
+    pending.reset();
+}
+
+bool TerrainLoader::start(const std::string& heightMapPath, const std::string& texturePath,
+    const std::vector<glm::vec3>& hikingData, const TerrainSettings& settings) {
+    if (pending) {
+        std::cerr << "A terrain is already loading" << std::endl;
+        return false;
+    }
+
+    TerrainSettings buildSettings = settings;
+    if (buildSettings.workerThreads == 0) {
+        buildSettings.workerThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    pending = std::make_unique<Terrain>();
+    startTime = std::chrono::steady_clock::now();
+    uploadFrames = 0;
+    Terrain* terrain = pending.get();
+    preparing = std::async(std::launch::async, [=]() {
+        return terrain->prepare(heightMapPath, texturePath, hikingData, buildSettings);
+    });
+    return true;
+}
+
+std::unique_ptr<Terrain> TerrainLoader::update(double budgetMs) {
+    if (!pending) return nullptr;
+
+    if (preparing.valid()) {
+        if (preparing.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return nullptr;
+        }
+        if (!preparing.get()) {
+            std::cerr << "Background terrain load failed" << std::endl;
+            pending.reset();
+            return nullptr;
+        }
+    }
+
+    ++uploadFrames;
+    if (!pending->uploadStep(budgetMs)) {
+        std::cerr << "Background terrain upload failed" << std::endl;
+        pending.reset();
+        return nullptr;
+    }
+    if (!pending->isReady()) {
+        return nullptr;
+    }
+
+    auto loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime);
+    std::cout << "Terrain loaded in the background in " << loadTime.count() << " ms, uploaded over "
+        << uploadFrames << " frame(s)" << std::endl;
+    return std::move(pending);
+}
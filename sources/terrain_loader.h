@@ -0,0 +1,45 @@
+// terrain_loader.h
+#pragma once
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "terrain.h"
+
+// Builds a Terrain in the background so the current one keeps rendering
+// while the next area is decoded, meshed and uploaded. Terrain::prepare
+// runs on a worker thread; update() then uploads the result in slices from
+// the GL thread, spending at most its budget per frame.
+class TerrainLoader {
+public:
+    TerrainLoader() = default;
+    ~TerrainLoader();
+
+    // Delete copy constructor and assignment operator
+    TerrainLoader(const TerrainLoader&) = delete;
+    TerrainLoader& operator=(const TerrainLoader&) = delete;
+
+    // Starts loading; false if a load is already in progress. Unless the
+    // settings say otherwise, the build leaves one hardware thread free
+    // for the render loop.
+    bool start(const std::string& heightMapPath, const std::string& texturePath,
+        const std::vector<glm::vec3>& hikingData, const TerrainSettings& settings = TerrainSettings());
+
+    // Call once per frame on the GL thread. Returns the finished terrain
+    // once, otherwise nullptr; a failed load is reported and dropped.
+    std::unique_ptr<Terrain> update(double budgetMs);
+
+    bool isLoading() const { return pending != nullptr; }
+
+    // Drops the load in progress. Terrain::prepare cannot be interrupted,
+    // so this waits for a build still running on the worker.
+    void cancel();
+
+private:
+    std::unique_ptr<Terrain> pending;
+    std::future<bool> preparing;
+    std::chrono::steady_clock::time_point startTime;
+    int uploadFrames{ 0 };
+};
@@ -0,0 +1,157 @@
+// terrain_occlusion.cpp
+#include "terrain_occlusion.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TERRAIN_OCCLUSION_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TERRAIN_OCCLUSION_SSE2 1
+#endif
+
+namespace {
+    constexpr float PI = 3.14159265f;
+
+    // Sky hidden behind a horizon of slope t = tan(h): sin(h)
+    inline float hiddenSky(float t) {
+        return t / std::sqrt(1.0f + t * t);
+    }
+
+    inline unsigned char toByte(float visible) {
+        return static_cast<unsigned char>(std::min(std::max(visible, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+OcclusionBaker::OcclusionBaker(const float* heights, int gridWidth, int gridHeight, float gridSpacing,
+    int directionCount, int searchRadius)
+    : width(gridWidth), height(gridHeight), radius(std::max(searchRadius, 1)), spacing(gridSpacing),
+    directions(std::max(directionCount, 1)) {
+    paddedWidth = width + 2 * radius;
+    const int paddedHeight = height + 2 * radius;
+    padded.resize(static_cast<size_t>(paddedWidth) * paddedHeight);
+    for (int z = 0; z < paddedHeight; ++z) {
+        const float* row = heights + static_cast<size_t>(std::min(std::max(z - radius, 0), height - 1)) * width;
+        float* target = padded.data() + static_cast<size_t>(z) * paddedWidth;
+        for (int x = 0; x < paddedWidth; ++x) {
+            target[x] = row[std::min(std::max(x - radius, 0), width - 1)];
+        }
+    }
+
+    // Distances 1, 2, 3, 4, 6, 8, 11, ... up to the radius
+    std::vector<float> distances;
+    for (float distance = 1.0f; distance <= static_cast<float>(radius);
+        distance = std::max(distance + 1.0f, std::round(distance * 1.41421356f))) {
+        distances.push_back(distance);
+    }
+    stepsPerDirection = static_cast<int>(distances.size());
+
+    steps.reserve(static_cast<size_t>(directions) * stepsPerDirection);
+    for (int d = 0; d < directions; ++d) {
+        float angle = (d + 0.5f) * 2.0f * PI / directions;
+        float dirX = std::cos(angle);
+        float dirZ = std::sin(angle);
+        for (float distance : distances) {
+            int dx = static_cast<int>(std::round(dirX * distance));
+            int dz = static_cast<int>(std::round(dirZ * distance));
+            if (dx == 0 && dz == 0) {
+                dx = dirX >= 0.0f ? 1 : -1;     // Never the sample itself
+            }
+            float length = std::sqrt(static_cast<float>(dx * dx + dz * dz)) * spacing;
+            steps.push_back({ dz * paddedWidth + dx, 1.0f / length });
+        }
+    }
+}
+
+void OcclusionBaker::bakeRows(int zBegin, int zEnd, unsigned char* occlusion) const {
+    const float invDirections = 1.0f / directions;
+    for (int z = zBegin; z < zEnd; ++z) {
+        const float* row = paddedSample(0, z);
+        unsigned char* out = occlusion + static_cast<size_t>(z) * width;
+        int x = 0;
+
+#if TERRAIN_OCCLUSION_AVX2
+        {
+            const __m256 one = _mm256_set1_ps(1.0f);
+            alignas(32) float visible[8];
+            for (; x + 8 <= width; x += 8) {
+                __m256 center = _mm256_loadu_ps(row + x);
+                __m256 hidden = _mm256_setzero_ps();
+                for (int d = 0; d < directions; ++d) {
+                    const Step* step = steps.data() + static_cast<size_t>(d) * stepsPerDirection;
+                    __m256 horizon = _mm256_setzero_ps();
+                    for (int s = 0; s < stepsPerDirection; ++s) {
+                        __m256 rise = _mm256_sub_ps(_mm256_loadu_ps(row + x + step[s].offset), center);
+                        horizon = _mm256_max_ps(horizon, _mm256_mul_ps(rise, _mm256_set1_ps(step[s].invDistance)));
+                    }
+                    __m256 length = _mm256_sqrt_ps(_mm256_add_ps(one, _mm256_mul_ps(horizon, horizon)));
+                    hidden = _mm256_add_ps(hidden, _mm256_div_ps(horizon, length));
+                }
+                _mm256_store_ps(visible, _mm256_sub_ps(one, _mm256_mul_ps(hidden, _mm256_set1_ps(invDirections))));
+                for (int lane = 0; lane < 8; ++lane) {
+                    out[x + lane] = toByte(visible[lane]);
+                }
+            }
+        }
+#endif
+#if TERRAIN_OCCLUSION_SSE2
+        {
+            const __m128 one = _mm_set1_ps(1.0f);
+            alignas(16) float visible[4];
+            for (; x + 4 <= width; x += 4) {
+                __m128 center = _mm_loadu_ps(row + x);
+                __m128 hidden = _mm_setzero_ps();
+                for (int d = 0; d < directions; ++d) {
+                    const Step* step = steps.data() + static_cast<size_t>(d) * stepsPerDirection;
+                    __m128 horizon = _mm_setzero_ps();
+                    for (int s = 0; s < stepsPerDirection; ++s) {
+                        __m128 rise = _mm_sub_ps(_mm_loadu_ps(row + x + step[s].offset), center);
+                        horizon = _mm_max_ps(horizon, _mm_mul_ps(rise, _mm_set1_ps(step[s].invDistance)));
+                    }
+                    __m128 length = _mm_sqrt_ps(_mm_add_ps(one, _mm_mul_ps(horizon, horizon)));
+                    hidden = _mm_add_ps(hidden, _mm_div_ps(horizon, length));
+                }
+                _mm_store_ps(visible, _mm_sub_ps(one, _mm_mul_ps(hidden, _mm_set1_ps(invDirections))));
+                for (int lane = 0; lane < 4; ++lane) {
+                    out[x + lane] = toByte(visible[lane]);
+                }
+            }
+        }
+#endif
+        for (; x < width; ++x) {
+            float center = row[x];
+            float hidden = 0.0f;
+            for (int d = 0; d < directions; ++d) {
+                const Step* step = steps.data() + static_cast<size_t>(d) * stepsPerDirection;
+                float horizon = 0.0f;
+                for (int s = 0; s < stepsPerDirection; ++s) {
+                    horizon = std::max(horizon, (row[x + step[s].offset] - center) * step[s].invDistance);
+                }
+                hidden += hiddenSky(horizon);
+            }
+            out[x] = toByte(1.0f - hidden * invDirections);
+        }
+    }
+}
+
+float OcclusionBaker::reference(int x, int z, int directionCount) const {
+    const float center = *paddedSample(x, z);
+    float hidden = 0.0f;
+    for (int d = 0; d < directionCount; ++d) {
+        float angle = (d + 0.5f) * 2.0f * PI / directionCount;
+        float dirX = std::cos(angle);
+        float dirZ = std::sin(angle);
+        float horizon = 0.0f;
+        for (int distance = 1; distance <= radius; ++distance) {
+            int dx = static_cast<int>(std::round(dirX * distance));
+            int dz = static_cast<int>(std::round(dirZ * distance));
+            if (dx == 0 && dz == 0) continue;
+            float length = std::sqrt(static_cast<float>(dx * dx + dz * dz)) * spacing;
+            horizon = std::max(horizon, (*paddedSample(x + dx, z + dz) - center) / length);
+        }
+        hidden += hiddenSky(horizon);
+    }
+    return 1.0f - hidden / directionCount;
+}
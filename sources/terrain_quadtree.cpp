@@ -0,0 +1,135 @@
+// terrain_quadtree.cpp
+#include "terrain_quadtree.h"
+#include "frustum.h"
+#include <algorithm>
+#include <limits>
+
+void TerrainQuadtree::build(const std::vector<float>& heights, int width, int height,
+    int nodePatchSize, float gridSpacing, int maxLevels) {
+    levels.clear();
+    patchSize = std::max(nodePatchSize, 2);
+    gridWidth = width;
+    gridHeight = height;
+    spacing = gridSpacing;
+    if (width < 2 || height < 2) return;
+
+    // Leaves: scan the samples of each patch, sharing the border row/column
+    Level leaves;
+    leaves.nodesX = (width - 1 + patchSize - 1) / patchSize;
+    leaves.nodesZ = (height - 1 + patchSize - 1) / patchSize;
+    leaves.heightRange.resize(static_cast<size_t>(leaves.nodesX) * leaves.nodesZ);
+    for (int nz = 0; nz < leaves.nodesZ; ++nz) {
+        for (int nx = 0; nx < leaves.nodesX; ++nx) {
+            glm::vec2 range(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+            int x1 = std::min((nx + 1) * patchSize, width - 1);
+            int z1 = std::min((nz + 1) * patchSize, height - 1);
+            for (int z = nz * patchSize; z <= z1; ++z) {
+                for (int x = nx * patchSize; x <= x1; ++x) {
+                    float h = heights[static_cast<size_t>(z) * width + x];
+                    range.x = std::min(range.x, h);
+                    range.y = std::max(range.y, h);
+                }
+            }
+            leaves.heightRange[nz * leaves.nodesX + nx] = range;
+        }
+    }
+    levels.push_back(std::move(leaves));
+
+    // Parents merge their (up to) four children until one node is left
+    while ((levels.back().nodesX > 1 || levels.back().nodesZ > 1) &&
+        static_cast<int>(levels.size()) < maxLevels) {
+        const Level& child = levels.back();
+        Level parent;
+        parent.nodesX = (child.nodesX + 1) / 2;
+        parent.nodesZ = (child.nodesZ + 1) / 2;
+        parent.heightRange.assign(static_cast<size_t>(parent.nodesX) * parent.nodesZ,
+            glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()));
+        for (int cz = 0; cz < child.nodesZ; ++cz) {
+            for (int cx = 0; cx < child.nodesX; ++cx) {
+                glm::vec2& range = parent.heightRange[(cz / 2) * parent.nodesX + cx / 2];
+                const glm::vec2& childRange = child.heightRange[cz * child.nodesX + cx];
+                range.x = std::min(range.x, childRange.x);
+                range.y = std::max(range.y, childRange.y);
+            }
+        }
+        levels.push_back(std::move(parent));
+    }
+}
+
+void TerrainQuadtree::nodeBounds(int level, int nodeX, int nodeZ,
+    glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+    const int size = patchSize << level;
+    const glm::vec2& range = levels[level].heightRange[nodeZ * levels[level].nodesX + nodeX];
+
+    // Nodes on the far edges are clipped to the grid, like the patch vertices
+    int x0 = nodeX * size;
+    int z0 = nodeZ * size;
+    int x1 = std::min(x0 + size, gridWidth - 1);
+    int z1 = std::min(z0 + size, gridHeight - 1);
+    boundsMin = glm::vec3((x0 - gridWidth / 2) * spacing, range.x, (z0 - gridHeight / 2) * spacing);
+    boundsMax = glm::vec3((x1 - gridWidth / 2) * spacing, range.y, (z1 - gridHeight / 2) * spacing);
+}
+
+void TerrainQuadtree::select(const Frustum& frustum, const glm::vec3& cameraPosition,
+    const std::vector<float>& ranges, std::vector<LodSelection>& selection) const {
+    selection.clear();
+    if (levels.empty()) return;
+
+    const int top = getLevelCount() - 1;
+    const Level& root = levels[top];
+    for (int nz = 0; nz < root.nodesZ; ++nz) {
+        for (int nx = 0; nx < root.nodesX; ++nx) {
+            if (selectNode(top, nx, nz, frustum, cameraPosition, ranges, selection)) continue;
+
+            // Beyond even the coarsest range: still draw it at the coarsest level
+            glm::vec3 boundsMin, boundsMax;
+            nodeBounds(top, nx, nz, boundsMin, boundsMax);
+            if (frustum.intersectsAABB(boundsMin, boundsMax)) {
+                int size = patchSize << top;
+                selection.push_back({ nx * size, nz * size, top, 0xF });
+            }
+        }
+    }
+}
+
+bool TerrainQuadtree::selectNode(int level, int nodeX, int nodeZ, const Frustum& frustum,
+    const glm::vec3& cameraPosition, const std::vector<float>& ranges,
+    std::vector<LodSelection>& selection) const {
+    glm::vec3 boundsMin, boundsMax;
+    nodeBounds(level, nodeX, nodeZ, boundsMin, boundsMax);
+
+    // Out of this level's range: the parent has to cover this area
+    if (!sphereIntersectsAABB(cameraPosition, ranges[level], boundsMin, boundsMax)) {
+        return false;
+    }
+
+    // Invisible nodes count as handled so the parent does not draw them either
+    if (!frustum.intersectsAABB(boundsMin, boundsMax)) {
+        return true;
+    }
+
+    const int size = patchSize << level;
+    LodSelection node{ nodeX * size, nodeZ * size, level, 0xF };
+    if (level == 0 || !sphereIntersectsAABB(cameraPosition, ranges[level - 1], boundsMin, boundsMax)) {
+        selection.push_back(node);
+        return true;
+    }
+
+    // Refine; children that fall outside the finer range stay with this node
+    const Level& children = levels[level - 1];
+    node.quadrants = 0;
+    for (int dz = 0; dz < 2; ++dz) {
+        for (int dx = 0; dx < 2; ++dx) {
+            int childX = nodeX * 2 + dx;
+            int childZ = nodeZ * 2 + dz;
+            if (childX >= children.nodesX || childZ >= children.nodesZ) continue;
+            if (!selectNode(level - 1, childX, childZ, frustum, cameraPosition, ranges, selection)) {
+                node.quadrants |= 1u << (dz * 2 + dx);
+            }
+        }
+    }
+    if (node.quadrants) {
+        selection.push_back(node);
+    }
+    return true;
+}
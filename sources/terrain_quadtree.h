@@ -0,0 +1,55 @@
+// terrain_quadtree.h
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Frustum;
+
+// A quadtree node (or some of its quadrants) picked for drawing this frame
+struct LodSelection {
+    int gridX{ 0 };                 // Grid sample of the node's corner
+    int gridZ{ 0 };
+    int level{ 0 };                 // 0 = finest, grid step is 1 << level
+    unsigned int quadrants{ 0xF };  // Bit (dz * 2 + dx) set for each quarter to draw
+    int layer{ 0 };                 // Texture array layer of its heights (streaming only)
+};
+
+// CDLOD quadtree over a height grid. Every node covers patchSize quads at a
+// grid step of 1 << level, so all nodes can be drawn with one shared patch
+// mesh. Nodes keep only their min/max height; positions are implicit.
+class TerrainQuadtree {
+public:
+    // Merges levels until one root is left or maxLevels exist; in the latter
+    // case the coarsest level has several roots.
+    void build(const std::vector<float>& heights, int width, int height,
+        int patchSize, float spacing, int maxLevels);
+    void clear() { levels.clear(); }
+
+    int getLevelCount() const { return static_cast<int>(levels.size()); }
+    int getPatchSize() const { return patchSize; }
+
+    // ranges[level] is the distance up to which that level may be drawn.
+    // A node is refined while its children's range still reaches it, and a
+    // child outside its range is drawn as a quadrant of its parent, so
+    // neighbouring selections never differ by more than one level.
+    void select(const Frustum& frustum, const glm::vec3& cameraPosition,
+        const std::vector<float>& ranges, std::vector<LodSelection>& selection) const;
+
+private:
+    struct Level {
+        int nodesX{ 0 };
+        int nodesZ{ 0 };
+        std::vector<glm::vec2> heightRange;  // (min, max) per node, row-major
+    };
+
+    std::vector<Level> levels;  // levels[0] holds the leaves
+    int patchSize{ 32 };
+    int gridWidth{ 0 };
+    int gridHeight{ 0 };
+    float spacing{ 1.0f };
+
+    void nodeBounds(int level, int nodeX, int nodeZ, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+    bool selectNode(int level, int nodeX, int nodeZ, const Frustum& frustum,
+        const glm::vec3& cameraPosition, const std::vector<float>& ranges,
+        std::vector<LodSelection>& selection) const;
+};
@@ -0,0 +1,231 @@
+// terrain_raycast.cpp
+#include "terrain_raycast.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Clips [tEnter, tExit] to the ray's crossing of [lo, hi] along one axis
+    inline bool clipSlab(float origin, float direction, float invDirection, float lo, float hi,
+        float& tEnter, float& tExit) {
+        if (direction == 0.0f) {
+            return origin >= lo && origin <= hi;
+        }
+        float t0 = (lo - origin) * invDirection;
+        float t1 = (hi - origin) * invDirection;
+        if (t0 > t1) std::swap(t0, t1);
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+        return tEnter <= tExit;
+    }
+
+    // Moller-Trumbore, two-sided. Updates tHit if the triangle is hit in [tMin, tHit).
+    inline bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+        const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float tMin, float& tHit) {
+        glm::vec3 edge1 = b - a;
+        glm::vec3 edge2 = c - a;
+        glm::vec3 p = glm::cross(direction, edge2);
+        float det = glm::dot(edge1, p);
+        if (det == 0.0f) return false;
+
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - a;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+        float t = glm::dot(edge2, q) * invDet;
+        if (t < tMin || t >= tHit) return false;
+        tHit = t;
+        return true;
+    }
+}
+
+void TerrainRaycaster::build(const std::vector<float>& heightGrid, int width, int height, float gridSpacing) {
+    clear();
+    heights = heightGrid.data();
+    gridWidth = width;
+    gridHeight = height;
+    spacing = gridSpacing;
+    if (width < 2 || height < 2) return;
+
+    // Level 1: blocks of 2x2 quads, from their 3x3 corner samples
+    Level blocks;
+    blocks.nodesX = width / 2;     // Half the quads, rounded up
+    blocks.nodesZ = height / 2;
+    blocks.heightRange.resize(static_cast<size_t>(blocks.nodesX) * blocks.nodesZ);
+    for (int nz = 0; nz < blocks.nodesZ; ++nz) {
+        int z1 = std::min(nz * 2 + 2, height - 1);
+        for (int nx = 0; nx < blocks.nodesX; ++nx) {
+            int x1 = std::min(nx * 2 + 2, width - 1);
+            glm::vec2 range(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+            for (int z = nz * 2; z <= z1; ++z) {
+                for (int x = nx * 2; x <= x1; ++x) {
+                    float h = heights[static_cast<size_t>(z) * width + x];
+                    range.x = std::min(range.x, h);
+                    range.y = std::max(range.y, h);
+                }
+            }
+            blocks.heightRange[static_cast<size_t>(nz) * blocks.nodesX + nx] = range;
+        }
+    }
+    levels.push_back(std::move(blocks));
+
+    // Parents merge their (up to) four children until one node is left
+    while (levels.back().nodesX > 1 || levels.back().nodesZ > 1) {
+        const Level& child = levels.back();
+        Level parent;
+        parent.nodesX = (child.nodesX + 1) / 2;
+        parent.nodesZ = (child.nodesZ + 1) / 2;
+        parent.heightRange.assign(static_cast<size_t>(parent.nodesX) * parent.nodesZ,
+            glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()));
+        for (int cz = 0; cz < child.nodesZ; ++cz) {
+            for (int cx = 0; cx < child.nodesX; ++cx) {
+                glm::vec2& range = parent.heightRange[static_cast<size_t>(cz / 2) * parent.nodesX + cx / 2];
+                const glm::vec2& childRange = child.heightRange[static_cast<size_t>(cz) * child.nodesX + cx];
+                range.x = std::min(range.x, childRange.x);
+                range.y = std::max(range.y, childRange.y);
+            }
+        }
+        levels.push_back(std::move(parent));
+    }
+}
+
+void TerrainRaycaster::clear() {
+    heights = nullptr;
+    gridWidth = 0;
+    gridHeight = 0;
+    levels.clear();
+}
+
+TerrainRayHit TerrainRaycaster::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+    TerrainRayHit result;
+    if (levels.empty()) return result;
+
+    GridRay ray;
+    ray.origin = glm::vec3(origin.x / spacing + static_cast<float>(gridWidth / 2), origin.y,
+        origin.z / spacing + static_cast<float>(gridHeight / 2));
+    ray.direction = glm::vec3(direction.x / spacing, direction.y, direction.z / spacing);
+    ray.invDirection = glm::vec3(1.0f) / ray.direction;
+
+    const int top = static_cast<int>(levels.size());
+    float tEnter = 0.0f;
+    float tExit = maxDistance;
+    if (!nodeInterval(ray, top, 0, 0, tEnter, tExit)) return result;
+
+    float tHit = maxDistance;
+    glm::vec3 normal;
+    if (intersectNode(ray, top, 0, 0, 0.0f, tHit, normal)) {
+        result.hit = true;
+        result.distance = tHit;
+        result.position = origin + direction * tHit;
+        result.normal = normal;
+    }
+    return result;
+}
+
+void TerrainRaycaster::raycast(const glm::vec3* origins, const glm::vec3* directions, TerrainRayHit* hits,
+    size_t count, float maxDistance, ThreadPool* pool) const {
+    auto castRange = [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            hits[i] = raycast(origins[i], directions[i], maxDistance);
+        }
+    };
+    if (pool && count > 1) {
+        pool->parallelFor(0, static_cast<int>(count), castRange);
+    }
+    else {
+        castRange(0, static_cast<int>(count));
+    }
+}
+
+bool TerrainRaycaster::nodeInterval(const GridRay& ray, int level, int nodeX, int nodeZ,
+    float& tEnter, float& tExit) const {
+    // Nodes on the far edges are clipped to the grid
+    const int size = 1 << level;
+    float x0 = static_cast<float>(nodeX * size);
+    float z0 = static_cast<float>(nodeZ * size);
+    float x1 = static_cast<float>(std::min((nodeX + 1) * size, gridWidth - 1));
+    float z1 = static_cast<float>(std::min((nodeZ + 1) * size, gridHeight - 1));
+    const Level& nodes = levels[level - 1];
+    const glm::vec2& range = nodes.heightRange[static_cast<size_t>(nodeZ) * nodes.nodesX + nodeX];
+
+    return clipSlab(ray.origin.x, ray.direction.x, ray.invDirection.x, x0, x1, tEnter, tExit) &&
+        clipSlab(ray.origin.z, ray.direction.z, ray.invDirection.z, z0, z1, tEnter, tExit) &&
+        clipSlab(ray.origin.y, ray.direction.y, ray.invDirection.y, range.x, range.y, tEnter, tExit);
+}
+
+bool TerrainRaycaster::intersectNode(const GridRay& ray, int level, int nodeX, int nodeZ, float tMin,
+    float& tHit, glm::vec3& normal) const {
+    // Blocks of 2x2 quads: test all of them and keep the nearest
+    if (level == 1) {
+        bool found = false;
+        for (int dz = 0; dz < 2; ++dz) {
+            for (int dx = 0; dx < 2; ++dx) {
+                int quadX = nodeX * 2 + dx;
+                int quadZ = nodeZ * 2 + dz;
+                if (quadX >= gridWidth - 1 || quadZ >= gridHeight - 1) continue;
+                found |= intersectQuad(ray, quadX, quadZ, tMin, tHit, normal);
+            }
+        }
+        return found;
+    }
+
+    // Children whose boxes the ray crosses, front to back
+    struct Child {
+        float tEnter;
+        int nodeX;
+        int nodeZ;
+    };
+    Child children[4];
+    int childCount = 0;
+    const Level& childLevel = levels[level - 2];
+    for (int dz = 0; dz < 2; ++dz) {
+        for (int dx = 0; dx < 2; ++dx) {
+            int childX = nodeX * 2 + dx;
+            int childZ = nodeZ * 2 + dz;
+            if (childX >= childLevel.nodesX || childZ >= childLevel.nodesZ) continue;
+            float tEnter = tMin;
+            float tExit = tHit;
+            if (nodeInterval(ray, level - 1, childX, childZ, tEnter, tExit)) {
+                children[childCount++] = { tEnter, childX, childZ };
+            }
+        }
+    }
+    std::sort(children, children + childCount, [](const Child& a, const Child& b) { return a.tEnter < b.tEnter; });
+
+    bool found = false;
+    for (int i = 0; i < childCount; ++i) {
+        // Everything further on starts behind the hit already found
+        if (children[i].tEnter >= tHit) break;
+        found |= intersectNode(ray, level - 1, children[i].nodeX, children[i].nodeZ, tMin, tHit, normal);
+    }
+    return found;
+}
+
+bool TerrainRaycaster::intersectQuad(const GridRay& ray, int quadX, int quadZ, float tMin,
+    float& tHit, glm::vec3& normal) const {
+    const float* row0 = heights + static_cast<size_t>(quadZ) * gridWidth + quadX;
+    const float* row1 = row0 + gridWidth;
+    float x0 = static_cast<float>(quadX);
+    float z0 = static_cast<float>(quadZ);
+    glm::vec3 topLeft(x0, row0[0], z0);
+    glm::vec3 topRight(x0 + 1.0f, row0[1], z0);
+    glm::vec3 bottomLeft(x0, row1[0], z0 + 1.0f);
+    glm::vec3 bottomRight(x0 + 1.0f, row1[1], z0 + 1.0f);
+
+    // Same split and winding as the index buffer; the normal is taken in
+    // world space, where the winding makes it point up
+    const glm::vec3 worldScale(spacing, 1.0f, spacing);
+    bool found = false;
+    if (intersectTriangle(ray.origin, ray.direction, topLeft, bottomLeft, topRight, tMin, tHit)) {
+        normal = glm::normalize(glm::cross((bottomLeft - topLeft) * worldScale, (topRight - topLeft) * worldScale));
+        found = true;
+    }
+    if (intersectTriangle(ray.origin, ray.direction, topRight, bottomLeft, bottomRight, tMin, tHit)) {
+        normal = glm::normalize(glm::cross((bottomLeft - topRight) * worldScale, (bottomRight - topRight) * worldScale));
+        found = true;
+    }
+    return found;
+}
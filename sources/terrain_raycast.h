@@ -0,0 +1,66 @@
+// terrain_raycast.h
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+struct TerrainRayHit {
+    bool hit{ false };
+    float distance{ 0.0f };         // Ray parameter: position = origin + direction * distance
+    glm::vec3 position{ 0.0f };
+    glm::vec3 normal{ 0.0f, 1.0f, 0.0f };  // Of the triangle that was hit
+};
+
+// Ray casts against the full-resolution grid triangles (split like
+// Terrain::generateTerrainIndices), accelerated by a min/max height
+// pyramid. Level k of the pyramid bounds blocks of 2^k x 2^k quads; a ray
+// only descends into blocks whose bounding box it actually crosses, front
+// to back, and stops at the first hit, so flat stretches of open air are
+// skipped in a few steps and a ray costs O(log N) on average.
+//
+// The grid is placed like the terrain mesh: sample (x, z) is at world
+// ((x - width / 2) * spacing, height, (z - height / 2) * spacing). The
+// heights are not copied and must stay alive and unchanged until the next
+// build().
+class TerrainRaycaster {
+public:
+    void build(const std::vector<float>& heights, int width, int height, float spacing);
+    void clear();
+
+    // Nearest hit within maxDistance along the ray; direction need not be
+    // normalized (distance is then in units of its length)
+    TerrainRayHit raycast(const glm::vec3& origin, const glm::vec3& direction,
+        float maxDistance = std::numeric_limits<float>::max()) const;
+
+    // raycast for count rays, split across the pool's workers when given
+    void raycast(const glm::vec3* origins, const glm::vec3* directions, TerrainRayHit* hits,
+        size_t count, float maxDistance = std::numeric_limits<float>::max(), ThreadPool* pool = nullptr) const;
+
+private:
+    struct Level {
+        int nodesX{ 0 };
+        int nodesZ{ 0 };
+        std::vector<glm::vec2> heightRange;  // (min, max) per node, row-major
+    };
+
+    // Ray in grid space: x and z in samples, y in metres. The scaling keeps
+    // the ray parameter of world space.
+    struct GridRay {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        glm::vec3 invDirection;
+    };
+
+    const float* heights{ nullptr };
+    int gridWidth{ 0 };
+    int gridHeight{ 0 };
+    float spacing{ 1.0f };
+    std::vector<Level> levels;  // levels[k - 1] holds the blocks of 2^k quads
+
+    bool nodeInterval(const GridRay& ray, int level, int nodeX, int nodeZ, float& tEnter, float& tExit) const;
+    bool intersectNode(const GridRay& ray, int level, int nodeX, int nodeZ, float tMin, float& tHit, glm::vec3& normal) const;
+    bool intersectQuad(const GridRay& ray, int quadX, int quadZ, float tMin, float& tHit, glm::vec3& normal) const;
+};
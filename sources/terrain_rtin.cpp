@@ -0,0 +1,181 @@
+// terrain_rtin.cpp
+#include "terrain_rtin.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // Error that forces a split, for triangles that cross the grid border
+    constexpr float FORCE_SPLIT = std::numeric_limits<float>::max();
+
+    // Largest vertical distance between the flat triangle through three grid
+    // samples and the samples it covers
+    float triangleError(const std::vector<float>& heights, int width, int ax, int az, int bx, int bz, int cx, int cz) {
+        long long area = static_cast<long long>(bx - ax) * (cz - az) - static_cast<long long>(cx - ax) * (bz - az);
+        if (area == 0) return 0.0f;
+        if (area < 0) {
+            std::swap(bx, cx);
+            std::swap(bz, cz);
+            area = -area;
+        }
+
+        const int x[3] = { ax, bx, cx };
+        const int z[3] = { az, bz, cz };
+        float h[3];
+        for (int k = 0; k < 3; ++k) {
+            h[k] = heights[static_cast<size_t>(z[k]) * width + x[k]];
+        }
+
+        const float invArea = 1.0f / static_cast<float>(area);
+        const int x0 = std::min({ x[0], x[1], x[2] }), x1 = std::max({ x[0], x[1], x[2] });
+        const int z0 = std::min({ z[0], z[1], z[2] }), z1 = std::max({ z[0], z[1], z[2] });
+        float maxError = 0.0f;
+        for (int pz = z0; pz <= z1; ++pz) {
+            for (int px = x0; px <= x1; ++px) {
+                // Integer edge functions decide coverage exactly
+                long long e1 = static_cast<long long>(px - x[0]) * (z[2] - z[0]) - static_cast<long long>(x[2] - x[0]) * (pz - z[0]);
+                long long e2 = static_cast<long long>(x[1] - x[0]) * (pz - z[0]) - static_cast<long long>(px - x[0]) * (z[1] - z[0]);
+                long long e0 = area - e1 - e2;
+                if ((e0 | e1 | e2) < 0) continue;
+
+                float interpolated = (e0 * h[0] + e1 * h[1] + e2 * h[2]) * invArea;
+                maxError = std::max(maxError, std::fabs(interpolated - heights[static_cast<size_t>(pz) * width + px]));
+            }
+        }
+        return maxError;
+    }
+}
+
+void TerrainRtin::clear() {
+    errors.clear();
+    gridWidth = gridHeight = size = 0;
+}
+
+void TerrainRtin::build(const std::vector<float>& heights, int width, int height) {
+    clear();
+    if (width < 2 || height < 2) return;
+
+    gridWidth = width;
+    gridHeight = height;
+    int tileSize = 1;
+    while (tileSize < std::max(width, height) - 1) tileSize *= 2;
+    size = tileSize + 1;
+    errors.assign(static_cast<size_t>(size) * size, 0.0f);
+
+    const int lastX = width - 1;
+    const int lastZ = height - 1;
+    // Exact error of one triangle. Those crossing the border are always
+    // split and those in the padding are dropped, so neither reads samples.
+    auto errorOf = [&](int ax, int az, int bx, int bz, int cx, int cz) {
+        const int x0 = std::min({ ax, bx, cx }), x1 = std::max({ ax, bx, cx });
+        const int z0 = std::min({ az, bz, cz }), z1 = std::max({ az, bz, cz });
+        if ((x0 < lastX && x1 > lastX) || (z0 < lastZ && z1 > lastZ)) return FORCE_SPLIT;
+        if (x1 > lastX || z1 > lastZ) return 0.0f;
+        return triangleError(heights, width, ax, az, bx, bz, cx, cz);
+    };
+    auto errorAt = [&](int x, int z) -> float& {
+        return errors[static_cast<size_t>(z) * size + x];
+    };
+
+    // Levels from the smallest splittable triangles up, so children are
+    // final before their parents read them. At step s there are two kinds:
+    // triangles with an axis-aligned hypotenuse (an edge of an s-square,
+    // apex at the square's centre) split into halves of s/2-squares, and
+    // halves of s-squares split at the square's centre into the former.
+    for (int step = 2; step <= tileSize; step *= 2) {
+        const int half = step / 2;
+
+        // Edge midpoints of the s-squares. Children are the s/2-square
+        // diagonals from each end to the centres on either side.
+        for (int z = 0; z < size; z += half) {
+            const bool horizontal = (z / half) % 2 == 0;
+            for (int x = horizontal ? half : 0; x < size; x += step) {
+                int ax = horizontal ? x - half : x;
+                int az = horizontal ? z : z - half;
+                int bx = horizontal ? x + half : x;
+                int bz = horizontal ? z : z + half;
+
+                float error = 0.0f;
+                for (int side = -1; side <= 1; side += 2) {
+                    int cx = horizontal ? x : x + side * half;
+                    int cz = horizontal ? z + side * half : z;
+                    if (cx < 0 || cz < 0 || cx >= size || cz >= size) continue;
+
+                    error = std::max(error, errorOf(ax, az, bx, bz, cx, cz));
+                    if (half > 1) {
+                        error = std::max(error, errorAt((ax + cx) / 2, (az + cz) / 2));
+                        error = std::max(error, errorAt((bx + cx) / 2, (bz + cz) / 2));
+                    }
+                }
+                errorAt(x, z) = error;
+            }
+        }
+
+        // Centres of the s-squares. The diagonal alternates so that each
+        // quadrant's diagonal runs through its parent's centre; children are
+        // the four edges.
+        for (int z = half; z < size; z += step) {
+            for (int x = half; x < size; x += step) {
+                int x0 = x - half, z0 = z - half, x1 = x + half, z1 = z + half;
+                bool mainDiagonal = ((x0 / step) + (z0 / step)) % 2 == 0;
+                float error = mainDiagonal
+                    ? std::max(errorOf(x0, z0, x1, z1, x1, z0), errorOf(x0, z0, x1, z1, x0, z1))
+                    : std::max(errorOf(x1, z0, x0, z1, x0, z0), errorOf(x1, z0, x0, z1, x1, z1));
+                error = std::max({ error, errorAt(x, z0), errorAt(x, z1), errorAt(x0, z), errorAt(x1, z) });
+                errorAt(x, z) = error;
+            }
+        }
+    }
+}
+
+void TerrainRtin::extract(float maxError, std::vector<unsigned int>& indices) const {
+    indices.clear();
+    if (errors.empty()) return;
+
+    // The two halves of the padded square, split along the main diagonal
+    const int max = size - 1;
+    extractTriangle(0, 0, max, max, max, 0, maxError, indices);
+    extractTriangle(max, max, 0, 0, 0, max, maxError, indices);
+}
+
+void TerrainRtin::extractTriangle(int ax, int az, int bx, int bz, int cx, int cz,
+    float maxError, std::vector<unsigned int>& indices) const {
+    // a-b is the hypotenuse and c the right-angle apex
+    const int mx = (ax + bx) / 2;
+    const int mz = (az + bz) / 2;
+    if (std::abs(ax - cx) + std::abs(az - cz) > 1 && errors[static_cast<size_t>(mz) * size + mx] > maxError) {
+        extractTriangle(cx, cz, ax, az, mx, mz, maxError, indices);
+        extractTriangle(bx, bz, cx, cz, mx, mz, maxError, indices);
+        return;
+    }
+
+    // Triangles never cross the border, so the apex decides inside or out
+    // unless it lies on the border itself; the centroid settles that
+    if (ax + bx + cx > 3 * (gridWidth - 1) || az + bz + cz > 3 * (gridHeight - 1)) return;
+
+    auto index = [&](int x, int z) { return static_cast<unsigned int>(z * gridWidth + x); };
+
+    // Counter-clockwise seen from above (+y), as the regular grid triangles
+    if ((bz - az) * (cx - ax) - (bx - ax) * (cz - az) > 0) {
+        indices.push_back(index(ax, az));
+        indices.push_back(index(bx, bz));
+        indices.push_back(index(cx, cz));
+    }
+    else {
+        indices.push_back(index(ax, az));
+        indices.push_back(index(cx, cz));
+        indices.push_back(index(bx, bz));
+    }
+}
+
+float TerrainRtin::measureError(const std::vector<float>& heights, int width,
+    const std::vector<unsigned int>& indices) {
+    float maxError = 0.0f;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        maxError = std::max(maxError, triangleError(heights, width,
+            indices[i] % width, indices[i] / width,
+            indices[i + 1] % width, indices[i + 1] / width,
+            indices[i + 2] % width, indices[i + 2] / width));
+    }
+    return maxError;
+}
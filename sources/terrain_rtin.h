@@ -0,0 +1,37 @@
+// terrain_rtin.h
+#pragma once
+#include <vector>
+
+// Right-triangulated irregular network over a height grid (after Mapbox's
+// Martini). The grid is covered by a binary tree of right triangles, each
+// split at the midpoint of its hypotenuse. build() stores, per midpoint, the
+// largest vertical error of any triangle that splitting there would remove,
+// so extract() can cut the tree at any error threshold. Errors propagate to
+// ancestors and are shared by the two triangles on a hypotenuse, which keeps
+// every cut free of cracks and T-junctions.
+//
+// Grids of any size are handled by padding them to 2^k + 1 samples; the
+// triangles crossing the grid border are always split so the mesh follows it.
+class TerrainRtin {
+public:
+    void build(const std::vector<float>& heights, int width, int height);
+    void clear();
+
+    // Triangles (as z * width + x grid indices) whose maximum vertical error
+    // is at most maxError, wound like Terrain::generateTerrainIndices
+    void extract(float maxError, std::vector<unsigned int>& indices) const;
+
+    // Largest vertical distance between the grid samples and the triangles
+    // covering them
+    static float measureError(const std::vector<float>& heights, int width,
+        const std::vector<unsigned int>& indices);
+
+private:
+    int gridWidth{ 0 };
+    int gridHeight{ 0 };
+    int size{ 0 };                  // Padded samples per side, 2^k + 1
+    std::vector<float> errors;      // Per padded sample, size * size
+
+    void extractTriangle(int ax, int az, int bx, int bz, int cx, int cz,
+        float maxError, std::vector<unsigned int>& indices) const;
+};
@@ -0,0 +1,125 @@
+// terrain_splat.cpp
+#include "terrain_splat.h"
+#include "grid_normals.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    // Width of the fade over each band edge, on either side of it
+    constexpr float HEIGHT_FADE = 0.05f;
+    constexpr float SLOPE_FADE = 1.0f;
+
+    inline float smoothstep(float edge0, float edge1, float x) {
+        float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+        return t * t * (3.0f - 2.0f * t);
+    }
+
+    inline float bandWeight(float value, float lo, float hi, float top, float fade) {
+        float weight = 1.0f;
+        if (lo > 0.0f) weight *= smoothstep(lo - fade, lo + fade, value);
+        if (hi < top) weight *= 1.0f - smoothstep(hi - fade, hi + fade, value);
+        return weight;
+    }
+
+    // Bilinear, texel centres to texel centres, so halving the size
+    // averages 2x2 blocks
+    void resampleRgb(const unsigned char* source, int sourceWidth, int sourceHeight,
+        unsigned char* target, int width, int height) {
+        const float scaleX = static_cast<float>(sourceWidth) / width;
+        const float scaleY = static_cast<float>(sourceHeight) / height;
+        for (int y = 0; y < height; ++y) {
+            float sy = std::min(std::max((y + 0.5f) * scaleY - 0.5f, 0.0f), static_cast<float>(sourceHeight - 1));
+            int y0 = static_cast<int>(sy);
+            int y1 = std::min(y0 + 1, sourceHeight - 1);
+            float fy = sy - y0;
+            for (int x = 0; x < width; ++x) {
+                float sx = std::min(std::max((x + 0.5f) * scaleX - 0.5f, 0.0f), static_cast<float>(sourceWidth - 1));
+                int x0 = static_cast<int>(sx);
+                int x1 = std::min(x0 + 1, sourceWidth - 1);
+                float fx = sx - x0;
+                for (int c = 0; c < 3; ++c) {
+                    auto texel = [&](int tx, int ty) {
+                        return static_cast<float>(source[(static_cast<size_t>(ty) * sourceWidth + tx) * 3 + c]);
+                    };
+                    float top = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * fx;
+                    float bottom = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * fx;
+                    target[(static_cast<size_t>(y) * width + x) * 3 + c] =
+                        static_cast<unsigned char>(top + (bottom - top) * fy + 0.5f);
+                }
+            }
+        }
+    }
+}
+
+bool packMaterialLayers(const std::vector<DecodedImage>& layers,
+    int& width, int& height, std::vector<unsigned char>& texels) {
+    if (layers.empty() || layers.size() > static_cast<size_t>(MAX_TERRAIN_MATERIALS)) {
+        std::cerr << "Terrain materials: between 1 and " << MAX_TERRAIN_MATERIALS << " are supported" << std::endl;
+        return false;
+    }
+    for (const auto& layer : layers) {
+        if (!layer.pixels || layer.channels != 3) {
+            std::cerr << "Failed to load material texture " << layer.path << ": " << layer.error << std::endl;
+            return false;
+        }
+    }
+
+    // The first material sets the size of every layer
+    width = layers.front().width;
+    height = layers.front().height;
+    const size_t layerBytes = static_cast<size_t>(width) * height * 3;
+    texels.resize(layerBytes * layers.size());
+    for (size_t layer = 0; layer < layers.size(); ++layer) {
+        const DecodedImage& image = layers[layer];
+        unsigned char* target = texels.data() + layerBytes * layer;
+        if (image.width == width && image.height == height) {
+            std::copy(image.pixels.get(), image.pixels.get() + layerBytes, target);
+        }
+        else {
+            resampleRgb(image.pixels.get(), image.width, image.height, target, width, height);
+        }
+    }
+    return true;
+}
+
+void computeSplatRow(const float* heights, int width, int height, float spacing,
+    float minHeight, float maxHeight, const std::vector<TerrainMaterial>& materials,
+    int z, unsigned char* splatMap) {
+    std::vector<float> normalX(width), normalY(width), normalZ(width);
+    computeGridNormalRow(heights, width, height, spacing, z, normalX.data(), normalY.data(), normalZ.data());
+
+    const int materialCount = static_cast<int>(materials.size());
+    const int layerCount = (materialCount + 3) / 4;
+    const size_t layerTexels = static_cast<size_t>(width) * height;
+    const float range = maxHeight - minHeight;
+    const float toFraction = range > 0.0f ? 1.0f / range : 0.0f;
+    const float toDegrees = 180.0f / 3.14159265f;
+    float weights[MAX_TERRAIN_MATERIALS];
+
+    for (int x = 0; x < width; ++x) {
+        size_t sample = static_cast<size_t>(z) * width + x;
+        float heightFraction = (heights[sample] - minHeight) * toFraction;
+        float slope = std::acos(std::min(std::max(normalY[x], -1.0f), 1.0f)) * toDegrees;
+
+        float total = 0.0f;
+        for (int m = 0; m < materialCount; ++m) {
+            const TerrainMaterial& material = materials[m];
+            weights[m] = bandWeight(heightFraction, material.minHeight, material.maxHeight, 1.0f, HEIGHT_FADE) *
+                bandWeight(slope, material.minSlope, material.maxSlope, 90.0f, SLOPE_FADE);
+            total += weights[m];
+        }
+        if (total <= 0.0f) {
+            weights[0] = total = 1.0f;
+        }
+
+        const float scale = 255.0f / total;
+        for (int layer = 0; layer < layerCount; ++layer) {
+            unsigned char* texel = splatMap + (layer * layerTexels + sample) * 4;
+            for (int c = 0; c < 4; ++c) {
+                int m = layer * 4 + c;
+                texel[c] = m < materialCount ? static_cast<unsigned char>(weights[m] * scale + 0.5f) : 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,35 @@
+// terrain_splat.h
+#pragma once
+#include <string>
+#include <vector>
+#include "image_loader.h"
+
+// Layers of the splat-blended terrain material; the splat map holds one
+// 8-bit weight per layer in RGBA layers of its own
+const int MAX_TERRAIN_MATERIALS = 8;
+
+// One layer of the terrain material. Its weight at a grid sample is how well
+// the sample fits the height band (fractions of the terrain's height range)
+// times how well it fits the slope band (degrees from level), faded over the
+// band edges. A band that starts at 0 or reaches the top has no edge there.
+struct TerrainMaterial {
+    std::string texturePath;
+    float minHeight{ 0.0f };
+    float maxHeight{ 1.0f };
+    float minSlope{ 0.0f };
+    float maxSlope{ 90.0f };
+};
+
+// Packs the materials' decoded RGB textures (see ImageLoader), in material
+// order, as layers of one texture array, layer after layer. Layers of
+// another size than the first are resampled to it.
+bool packMaterialLayers(const std::vector<DecodedImage>& layers,
+    int& width, int& height, std::vector<unsigned char>& texels);
+
+// Splat weights of row z of a height grid (row-major, spacing world units
+// between samples). The splat map holds (materials + 3) / 4 RGBA8 layers of
+// width x height texels, one after the other; weights of a sample sum to 255
+// up to rounding, and a sample no band covers goes to the first material.
+void computeSplatRow(const float* heights, int width, int height, float spacing,
+    float minHeight, float maxHeight, const std::vector<TerrainMaterial>& materials,
+    int z, unsigned char* splatMap);
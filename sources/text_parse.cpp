@@ -0,0 +1,292 @@
+// text_parse.cpp
+#include "text_parse.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    // Every power of ten a double holds exactly
+    const double EXACT_POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    constexpr int MAX_EXACT_EXPONENT = 22;
+    constexpr uint64_t MAX_EXACT_MANTISSA = uint64_t(1) << 53;
+    constexpr int MAX_MANTISSA_DIGITS = 19;     // Fit a uint64_t
+
+    inline bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    inline unsigned digitValue(char c) {
+        return static_cast<unsigned>(c - '0');     // Above 9 for non-digits
+    }
+
+    inline bool areDigits(unsigned a, unsigned b) {
+        return (a <= 9) & (b <= 9);
+    }
+
+    inline bool isLeapYear(int year) {
+        return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    }
+
+    // Days from 1970-01-01 to a date of the proleptic Gregorian calendar
+    // (H. Hinnant's days_from_civil)
+    int64_t daysFromCivil(int year, unsigned month, unsigned day) {
+        year -= month <= 2;
+        const int64_t era = (year >= 0 ? year : year - 399) / 400;
+        const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+        const unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double megabytesPerSecond(size_t bytes, double seconds) {
+        return bytes / (1024.0 * 1024.0) / std::max(seconds, 1e-9);
+    }
+
+    // Reference conversion through the C library
+    double referenceTime(const char* text) {
+        std::tm fields = {};
+        if (std::sscanf(text, "%4d-%2d-%2dT%2d:%2d:%2dZ", &fields.tm_year, &fields.tm_mon, &fields.tm_mday,
+            &fields.tm_hour, &fields.tm_min, &fields.tm_sec) != 6) {
+            return -1.0;
+        }
+        fields.tm_year -= 1900;
+        fields.tm_mon -= 1;
+#ifdef _WIN32
+        return static_cast<double>(_mkgmtime(&fields));
+#else
+        return static_cast<double>(timegm(&fields));
+#endif
+    }
+}
+
+bool parseDecimal(const char* begin, const char* end, double& value, const char** parsedEnd) {
+    const char* p = begin;
+    while (p < end && isSpace(*p)) ++p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    // Significant digits into an integer; leading zeros don't count and
+    // digits past the 19th only move the exponent
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool anyDigit = false;
+    for (; p < end && digitValue(*p) <= 9; ++p) {
+        anyDigit = true;
+        if (digits < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + digitValue(*p);
+            digits += mantissa != 0;
+        }
+        else {
+            ++exponent;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && digitValue(*p) <= 9; ++p) {
+            anyDigit = true;
+            if (digits < MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + digitValue(*p);
+                digits += mantissa != 0;
+                --exponent;
+            }
+        }
+    }
+    if (!anyDigit) return false;
+
+    // The exponent only counts if digits follow the 'e'
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            negativeExponent = *q == '-';
+            ++q;
+        }
+        if (q < end && digitValue(*q) <= 9) {
+            int written = 0;
+            for (; q < end && digitValue(*q) <= 9; ++q) {
+                written = std::min(written * 10 + static_cast<int>(digitValue(*q)), 100000);
+            }
+            exponent += negativeExponent ? -written : written;
+            p = q;
+        }
+    }
+
+    // Both operands exact means one correctly rounded operation
+    double result;
+    if (mantissa == 0) {
+        result = 0.0;
+    }
+    else if (mantissa <= MAX_EXACT_MANTISSA && exponent >= -MAX_EXACT_EXPONENT && exponent <= MAX_EXACT_EXPONENT) {
+        result = exponent < 0
+            ? static_cast<double>(mantissa) / EXACT_POWERS_OF_TEN[-exponent]
+            : static_cast<double>(mantissa) * EXACT_POWERS_OF_TEN[exponent];
+    }
+    else {
+        // Rounds up to three times where long double is double (MSVC)
+        result = static_cast<double>(static_cast<long double>(mantissa) * std::pow(10.0L, exponent));
+    }
+    value = negative ? -result : result;
+    if (parsedEnd) *parsedEnd = p;
+    return true;
+}
+
+bool parseIso8601Time(const char* begin, const char* end, double& epochSeconds) {
+    const char* p = begin;
+    while (p < end && isSpace(*p)) ++p;
+    if (end - p < 19) return false;
+
+    // Fixed layout "YYYY-MM-DDThh:mm:ss": all digits checked in one go
+    const unsigned y0 = digitValue(p[0]), y1 = digitValue(p[1]), y2 = digitValue(p[2]), y3 = digitValue(p[3]);
+    const unsigned mo0 = digitValue(p[5]), mo1 = digitValue(p[6]), d0 = digitValue(p[8]), d1 = digitValue(p[9]);
+    const unsigned h0 = digitValue(p[11]), h1 = digitValue(p[12]), mi0 = digitValue(p[14]), mi1 = digitValue(p[15]);
+    const unsigned s0 = digitValue(p[17]), s1 = digitValue(p[18]);
+    const bool digitsValid = areDigits(y0, y1) & areDigits(y2, y3) & areDigits(mo0, mo1) & areDigits(d0, d1) &
+        areDigits(h0, h1) & areDigits(mi0, mi1) & areDigits(s0, s1);
+    const bool separatorsValid = p[4] == '-' && p[7] == '-' && (p[10] == 'T' || p[10] == 't' || p[10] == ' ') &&
+        p[13] == ':' && p[16] == ':';
+    if (!digitsValid || !separatorsValid) return false;
+
+    const int year = static_cast<int>(y0 * 1000 + y1 * 100 + y2 * 10 + y3);
+    const unsigned month = mo0 * 10 + mo1;
+    const unsigned day = d0 * 10 + d1;
+    const unsigned hour = h0 * 10 + h1;
+    const unsigned minute = mi0 * 10 + mi1;
+    const unsigned second = s0 * 10 + s1;     // 60 for a leap second
+    static const unsigned DAYS_IN_MONTH[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (month < 1 || month > 12 || day < 1 || hour > 23 || minute > 59 || second > 60) return false;
+    if (day > DAYS_IN_MONTH[month - 1] + (month == 2 && isLeapYear(year))) return false;
+    p += 19;
+
+    double fraction = 0.0;
+    if (p < end && (*p == '.' || *p == ',')) {
+        double scale = 0.1;
+        const char* digits = ++p;
+        for (; p < end && digitValue(*p) <= 9; ++p) {
+            fraction += digitValue(*p) * scale;
+            scale *= 0.1;
+        }
+        if (p == digits) return false;
+    }
+
+    // Zone suffix: offset of local time from UTC, in seconds
+    int zoneOffset = 0;
+    if (p < end && (*p == 'Z' || *p == 'z')) {
+        ++p;
+    }
+    else if (p < end && (*p == '+' || *p == '-')) {
+        const int sign = *p == '-' ? -1 : 1;
+        ++p;
+        if (end - p < 2) return false;
+        const unsigned zh0 = digitValue(p[0]), zh1 = digitValue(p[1]);
+        if (!areDigits(zh0, zh1)) return false;
+        const unsigned zoneHours = zh0 * 10 + zh1;
+        p += 2;
+        unsigned zoneMinutes = 0;
+        if (p < end && *p == ':') ++p;
+        if (end - p >= 2 && areDigits(digitValue(p[0]), digitValue(p[1]))) {
+            zoneMinutes = digitValue(p[0]) * 10 + digitValue(p[1]);
+            p += 2;
+        }
+        if (zoneHours > 23 || zoneMinutes > 59) return false;
+        zoneOffset = sign * static_cast<int>(zoneHours * 3600 + zoneMinutes * 60);
+    }
+    while (p < end && isSpace(*p)) ++p;
+    if (p != end) return false;
+
+    const int64_t days = daysFromCivil(year, month, day);
+    const int64_t seconds = days * 86400 + hour * 3600 + minute * 60 + second - zoneOffset;
+    epochSeconds = static_cast<double>(seconds) + fraction;
+    return true;
+}
+
+TextParseBenchmark benchmarkTextParsing(size_t count) {
+    TextParseBenchmark result;
+    result.values = count;
+
+    // Coordinates and elevations as GPX writers print them, and a track's
+    // worth of timestamps, each followed by a space
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<double> latitude(-90.0, 90.0);
+    std::uniform_real_distribution<double> elevation(-100.0, 4000.0);
+    std::uniform_int_distribution<int> seconds(0, 2000000000);
+    std::string numbers;
+    std::string times;
+    char buffer[64];
+    for (size_t i = 0; i < count; ++i) {
+        int length = (i % 2 == 0)
+            ? std::snprintf(buffer, sizeof(buffer), "%.7f ", latitude(random))
+            : std::snprintf(buffer, sizeof(buffer), "%.1f ", elevation(random));
+        numbers.append(buffer, length);
+
+        std::time_t time = static_cast<std::time_t>(seconds(random));
+        std::tm fields = {};
+#ifdef _WIN32
+        gmtime_s(&fields, &time);
+#else
+        gmtime_r(&time, &fields);
+#endif
+        length = static_cast<int>(std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ ", &fields));
+        times.append(buffer, length);
+    }
+
+    std::vector<double> parsed(count), reference(count);
+    auto start = std::chrono::steady_clock::now();
+    const char* p = numbers.data();
+    const char* end = numbers.data() + numbers.size();
+    for (size_t i = 0; i < count; ++i) {
+        parseDecimal(p, end, parsed[i], &p);
+    }
+    result.decimalMBps = megabytesPerSecond(numbers.size(), secondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    const char* q = numbers.c_str();
+    for (size_t i = 0; i < count; ++i) {
+        char* next = nullptr;
+        reference[i] = std::strtod(q, &next);
+        q = next;
+    }
+    result.referenceDecimalMBps = megabytesPerSecond(numbers.size(), secondsSince(start));
+    for (size_t i = 0; i < count; ++i) {
+        result.mismatches += parsed[i] != reference[i];
+    }
+
+    // Timestamps are fixed width: 20 characters and the space
+    const size_t TIME_STRIDE = 21;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        const char* time = times.data() + i * TIME_STRIDE;
+        if (!parseIso8601Time(time, time + TIME_STRIDE - 1, parsed[i])) parsed[i] = -1.0;
+    }
+    result.timeMBps = megabytesPerSecond(times.size(), secondsSince(start));
+
+    // Copied out first: sscanf may measure the whole remaining string
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        std::memcpy(buffer, times.data() + i * TIME_STRIDE, TIME_STRIDE - 1);
+        buffer[TIME_STRIDE - 1] = '\0';
+        reference[i] = referenceTime(buffer);
+    }
+    result.referenceTimeMBps = megabytesPerSecond(times.size(), secondsSince(start));
+    for (size_t i = 0; i < count; ++i) {
+        result.mismatches += parsed[i] != reference[i];
+    }
+    return result;
+}
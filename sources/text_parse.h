@@ -0,0 +1,37 @@
+// text_parse.h
+#pragma once
+#include <cstddef>
+
+// Number and time parsing for text formats such as GPX. Unlike strtod and
+// the iostreams these ignore the C locale, so "68.44" reads the same
+// whatever decimal separator the user's locale has, and they work on
+// unterminated [begin, end) ranges straight out of a mapped file.
+
+// Decimal number with optional sign, fraction and exponent ("-12.5e3");
+// leading whitespace is skipped. Correctly rounded for up to 15-16
+// significant digits (mantissa at most 2^53) with a decimal exponent of at
+// most 22 either way, which covers coordinates and elevations as GPS units
+// write them. Longer mantissas (17-digit "%.17g" output) or larger
+// exponents can be off by a few ulps, as on MSVC long double is double;
+// digits past the 19th are ignored. Sets *parsedEnd past the number if
+// given; false if there is no number at begin.
+bool parseDecimal(const char* begin, const char* end, double& value, const char** parsedEnd = nullptr);
+
+// ISO 8601 date and time, "2024-06-18T13:58:44Z", as seconds since the
+// Unix epoch. Takes fractional seconds, a 'T' or space separator and a
+// "Z", "+hh:mm", "-hhmm" or no zone suffix (then UTC); leading whitespace
+// is skipped. false for anything else, including out-of-range fields.
+bool parseIso8601Time(const char* begin, const char* end, double& epochSeconds);
+
+struct TextParseBenchmark {
+    size_t values{ 0 };
+    double decimalMBps{ 0.0 };          // parseDecimal
+    double referenceDecimalMBps{ 0.0 }; // strtod on the same text
+    double timeMBps{ 0.0 };             // parseIso8601Time
+    double referenceTimeMBps{ 0.0 };    // sscanf + timegm-style conversion
+    size_t mismatches{ 0 };             // Results that differ from the references
+};
+
+// Throughput of the parsers against the C library on count generated
+// coordinates and timestamps, with a check that the results agree
+TextParseBenchmark benchmarkTextParsing(size_t count);
@@ -0,0 +1,67 @@
+// thread_pool.cpp
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)>& fn) {
+    int count = end - begin;
+    if (count <= 0) return;
+
+    // A few bands per worker keeps the load balanced when rows differ in cost
+    int bands = std::min(count, static_cast<int>(size()) * 4);
+    if (bands <= 1) {
+        fn(begin, end);
+        return;
+    }
+
+    std::vector<std::future<void>> pending;
+    pending.reserve(bands);
+    for (int band = 0; band < bands; ++band) {
+        int bandBegin = begin + static_cast<int>(static_cast<long long>(count) * band / bands);
+        int bandEnd = begin + static_cast<int>(static_cast<long long>(count) * (band + 1) / bands);
+        pending.push_back(submit([&fn, bandBegin, bandEnd]() { fn(bandBegin, bandEnd); }));
+    }
+
+    // get() rethrows the first exception raised by a band
+    for (auto& band : pending) {
+        band.wait();
+    }
+    for (auto& band : pending) {
+        band.get();
+    }
+}
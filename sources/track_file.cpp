@@ -0,0 +1,355 @@
+// track_file.cpp
+#include "track_file.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <type_traits>
+
+constexpr float TrackFile::POSITION_STEP;
+
+namespace {
+    constexpr char TRACK_MAGIC[8] = { 'H', 'I', 'K', 'E', 'T', 'R', 'C', 'K' };
+
+    // Bump whenever the header, the directory or an encoding changes
+    constexpr uint32_t TRACK_VERSION = 1;
+
+    constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+    enum ColumnId : uint32_t {
+        COLUMN_POSITIONS = 0,
+        COLUMN_TIMES,
+        COLUMN_HEART_RATES,
+        COLUMN_CADENCES,
+        COLUMN_TEMPERATURES,
+        COLUMN_COUNT
+    };
+
+    enum ColumnEncoding : uint32_t {
+        ENCODING_RAW = 0,
+        ENCODING_DELTA_VARINT
+    };
+
+    struct TrackHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t columnCount;       // Directory entries after the header
+        uint64_t key;
+        uint64_t pointCount;
+        double originLongitude;
+        double originLatitude;
+    };
+
+    struct ColumnEntry {
+        uint32_t id;
+        uint32_t encoding;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // A column as written: its bytes, raw or encoded
+    struct ColumnData {
+        ColumnEntry entry;
+        const void* bytes;
+    };
+
+    uint64_t alignUp(uint64_t value) {
+        return (value + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    }
+
+    // Small magnitudes of either sign to small unsigned numbers
+    inline uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    // LEB128: seven bits per byte, low bits first, high bit set on all but the last
+    void putVarint(std::vector<unsigned char>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && p < end; shift += 7) {
+            unsigned char byte = *p++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    template<typename T>
+    bool hasRecordedValue(const std::vector<T>& values) {
+        for (T value : values) {
+            if (!std::isnan(value)) return true;
+        }
+        return false;
+    }
+
+    // Quantized values as deltas from the value components before them;
+    // false if a value is not finite (or too large to quantize)
+    bool encodeDeltas(const float* values, size_t count, size_t components, double scale,
+        std::vector<unsigned char>& out) {
+        std::vector<int64_t> previous(components, 0);
+        out.reserve(count * components * 2);
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t c = 0; c < components; ++c) {
+                double scaled = values[i * components + c] * scale;
+                if (!(std::fabs(scaled) < 9.0e15)) return false;
+                int64_t quantized = std::llround(scaled);
+                putVarint(out, zigzag(quantized - previous[c]));
+                previous[c] = quantized;
+            }
+        }
+        return true;
+    }
+
+    bool encodeTimeDeltas(const std::vector<double>& times, std::vector<unsigned char>& out) {
+        int64_t previous = 0;
+        out.reserve(times.size() * 2);
+        for (double time : times) {
+            double milliseconds = time * 1000.0;
+            if (!(std::fabs(milliseconds) < 9.0e15)) return false;
+            int64_t quantized = std::llround(milliseconds);
+            putVarint(out, zigzag(quantized - previous));
+            previous = quantized;
+        }
+        return true;
+    }
+}
+
+bool TrackFile::write(const std::string& path, uint64_t key, const HikeTrack& track, bool compress) {
+    const size_t count = track.size();
+    TrackHeader header{};
+    std::memcpy(header.magic, TRACK_MAGIC, sizeof(TRACK_MAGIC));
+    header.version = TRACK_VERSION;
+    header.key = key;
+    header.pointCount = count;
+    header.originLongitude = track.originLongitude;
+    header.originLatitude = track.originLatitude;
+
+    std::vector<ColumnData> columns;
+    auto addColumn = [&](uint32_t id, uint32_t encoding, const void* bytes, size_t size) {
+        columns.push_back({ { id, encoding, 0, size }, bytes });
+    };
+
+    std::vector<unsigned char> encodedPositions;
+    std::vector<unsigned char> encodedTimes;
+    if (compress && encodeDeltas(reinterpret_cast<const float*>(track.positions.data()), count, 3,
+        1.0 / POSITION_STEP, encodedPositions)) {
+        addColumn(COLUMN_POSITIONS, ENCODING_DELTA_VARINT, encodedPositions.data(), encodedPositions.size());
+    }
+    else {
+        addColumn(COLUMN_POSITIONS, ENCODING_RAW, track.positions.data(), count * sizeof(glm::vec3));
+    }
+    if (hasRecordedValue(track.times)) {
+        if (compress && encodeTimeDeltas(track.times, encodedTimes)) {
+            addColumn(COLUMN_TIMES, ENCODING_DELTA_VARINT, encodedTimes.data(), encodedTimes.size());
+        }
+        else {
+            addColumn(COLUMN_TIMES, ENCODING_RAW, track.times.data(), count * sizeof(double));
+        }
+    }
+    if (hasRecordedValue(track.heartRates)) {
+        addColumn(COLUMN_HEART_RATES, ENCODING_RAW, track.heartRates.data(), count * sizeof(float));
+    }
+    if (hasRecordedValue(track.cadences)) {
+        addColumn(COLUMN_CADENCES, ENCODING_RAW, track.cadences.data(), count * sizeof(float));
+    }
+    if (hasRecordedValue(track.temperatures)) {
+        addColumn(COLUMN_TEMPERATURES, ENCODING_RAW, track.temperatures.data(), count * sizeof(float));
+    }
+    header.columnCount = static_cast<uint32_t>(columns.size());
+
+    uint64_t offset = alignUp(sizeof(TrackHeader) + columns.size() * sizeof(ColumnEntry));
+    for (auto& column : columns) {
+        column.entry.offset = offset;
+        offset = alignUp(offset + column.entry.size);
+    }
+
+    // Per thread, as a batch load may write the same file twice at once
+    std::string tempPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to create track file: " << tempPath << std::endl;
+            return false;
+        }
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& column : columns) {
+            out.write(reinterpret_cast<const char*>(&column.entry), sizeof(ColumnEntry));
+        }
+        for (const auto& column : columns) {
+            static const char padding[SECTION_ALIGNMENT] = {};
+            uint64_t position = static_cast<uint64_t>(out.tellp());
+            out.write(padding, static_cast<std::streamsize>(column.entry.offset - position));
+            if (column.entry.size) {
+                out.write(static_cast<const char*>(column.bytes), static_cast<std::streamsize>(column.entry.size));
+            }
+        }
+
+        if (!out) {
+            std::cerr << "Failed to write track file: " << tempPath << std::endl;
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to rename track file: " << tempPath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TrackFile::open(const std::string& path, uint64_t key) {
+    close();
+    if (!file.open(path)) return false;
+
+    TrackHeader header;
+    if (file.size() < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, TRACK_MAGIC, sizeof(TRACK_MAGIC)) != 0 ||
+        header.version != TRACK_VERSION || header.key != key || header.columnCount > COLUMN_COUNT ||
+        sizeof(TrackHeader) + header.columnCount * sizeof(ColumnEntry) > file.size()) {
+        std::cerr << "Ignoring stale track file: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    auto invalid = [&]() {
+        std::cerr << "Ignoring invalid track file: " << path << std::endl;
+        close();
+        return false;
+    };
+    // Every point takes at least a byte in each column, which also keeps
+    // the column sizes below from overflowing
+    if (header.pointCount > file.size()) return invalid();
+    const size_t count = static_cast<size_t>(header.pointCount);
+    pointCount = count;
+    originLongitude = header.originLongitude;
+    originLatitude = header.originLatitude;
+
+    for (uint32_t i = 0; i < header.columnCount; ++i) {
+        ColumnEntry entry;
+        std::memcpy(&entry, file.data() + sizeof(TrackHeader) + i * sizeof(ColumnEntry), sizeof(entry));
+        if (entry.offset % SECTION_ALIGNMENT != 0 || entry.offset > file.size() || entry.size > file.size() - entry.offset) {
+            return invalid();
+        }
+        const unsigned char* bytes = file.data() + entry.offset;
+        const unsigned char* end = bytes + entry.size;
+
+        auto rawColumn = [&](size_t elementSize) {
+            return entry.encoding == ENCODING_RAW && entry.size == static_cast<uint64_t>(count) * elementSize;
+        };
+        switch (entry.id) {
+        case COLUMN_POSITIONS:
+            if (rawColumn(sizeof(glm::vec3))) {
+                positions = { reinterpret_cast<const glm::vec3*>(bytes), count };
+            }
+            else if (entry.encoding == ENCODING_DELTA_VARINT) {
+                decodedPositions.resize(count);
+                int64_t quantized[3] = { 0, 0, 0 };
+                for (size_t p = 0; p < count; ++p) {
+                    for (int c = 0; c < 3; ++c) {
+                        uint64_t delta;
+                        if (!getVarint(bytes, end, delta)) return invalid();
+                        quantized[c] += unzigzag(delta);
+                        decodedPositions[p][c] = static_cast<float>(quantized[c] * static_cast<double>(POSITION_STEP));
+                    }
+                }
+                positions = { decodedPositions.data(), count };
+            }
+            else {
+                return invalid();
+            }
+            break;
+        case COLUMN_TIMES:
+            if (rawColumn(sizeof(double))) {
+                times = { reinterpret_cast<const double*>(bytes), count };
+            }
+            else if (entry.encoding == ENCODING_DELTA_VARINT) {
+                decodedTimes.resize(count);
+                int64_t milliseconds = 0;
+                for (size_t p = 0; p < count; ++p) {
+                    uint64_t delta;
+                    if (!getVarint(bytes, end, delta)) return invalid();
+                    milliseconds += unzigzag(delta);
+                    decodedTimes[p] = milliseconds / 1000.0;
+                }
+                times = { decodedTimes.data(), count };
+            }
+            else {
+                return invalid();
+            }
+            break;
+        case COLUMN_HEART_RATES:
+        case COLUMN_CADENCES:
+        case COLUMN_TEMPERATURES: {
+            if (!rawColumn(sizeof(float))) return invalid();
+            TrackSpan<float> column{ reinterpret_cast<const float*>(bytes), count };
+            if (entry.id == COLUMN_HEART_RATES) heartRates = column;
+            else if (entry.id == COLUMN_CADENCES) cadences = column;
+            else temperatures = column;
+            break;
+        }
+        default:
+            return invalid();
+        }
+    }
+    if (positions.size != count) {
+        return invalid();
+    }
+    return true;
+}
+
+void TrackFile::close() {
+    file.close();
+    pointCount = 0;
+    originLongitude = 0.0;
+    originLatitude = 0.0;
+    positions = TrackSpan<glm::vec3>();
+    times = TrackSpan<double>();
+    heartRates = TrackSpan<float>();
+    cadences = TrackSpan<float>();
+    temperatures = TrackSpan<float>();
+    decodedPositions.clear();
+    decodedTimes.clear();
+}
+
+void TrackFile::copyTo(HikeTrack& track) const {
+    auto copyColumn = [this](const auto& column, auto& values) {
+        using Value = typename std::decay<decltype(values)>::type::value_type;
+        if (column.empty()) {
+            values.assign(pointCount, std::numeric_limits<Value>::quiet_NaN());
+        }
+        else {
+            values.assign(column.begin(), column.end());
+        }
+    };
+    track.originLongitude = originLongitude;
+    track.originLatitude = originLatitude;
+    track.positions.assign(positions.begin(), positions.end());
+    copyColumn(times, track.times);
+    copyColumn(heartRates, track.heartRates);
+    copyColumn(cadences, track.cadences);
+    copyColumn(temperatures, track.temperatures);
+}
@@ -0,0 +1,78 @@
+// track_file.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "hike_track.h"
+#include "mapped_file.h"
+
+// Read-only view of count values; empty for a column the track lacks
+template<typename T>
+struct TrackSpan {
+    const T* data{ nullptr };
+    size_t size{ 0 };
+
+    bool empty() const { return size == 0; }
+    size_t bytes() const { return size * sizeof(T); }
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    const T& operator[](size_t i) const { return data[i]; }
+};
+
+// Binary columnar file of a HikeTrack: a fixed header, a directory of its
+// columns and one 16-byte aligned section per column. Columns without a
+// single recorded value are left out.
+//
+// Columns are stored raw or, with compress, positions and times as
+// delta-coded zigzag varints: positions quantized to POSITION_STEP and
+// times to milliseconds, which typically takes them to 2-4 bytes per value.
+// A compressed column holding NaN is stored raw instead.
+//
+// Raw columns are read through a memory mapping without a copy, so the
+// spans can go straight to glBufferData; compressed ones are decoded into
+// arrays owned by the TrackFile when it is opened.
+class TrackFile {
+public:
+    // Quantization of compressed positions, in local units
+    static constexpr float POSITION_STEP = 1.0f / 256.0f;
+
+    // Writes to a temporary file and renames it, so concurrent readers
+    // never see a partial file. key is stored for open() to check.
+    static bool write(const std::string& path, uint64_t key, const HikeTrack& track, bool compress = false);
+
+    // Maps the file; fails on a missing file or a version or key mismatch
+    bool open(const std::string& path, uint64_t key);
+    void close();
+
+    size_t size() const { return pointCount; }
+    double getOriginLongitude() const { return originLongitude; }
+    double getOriginLatitude() const { return originLatitude; }
+
+    // Valid until close(); see HikeTrack for units
+    TrackSpan<glm::vec3> getPositions() const { return positions; }
+    TrackSpan<double> getTimes() const { return times; }
+    TrackSpan<float> getHeartRates() const { return heartRates; }
+    TrackSpan<float> getCadences() const { return cadences; }
+    TrackSpan<float> getTemperatures() const { return temperatures; }
+
+    // Copies every column, with NaN for the ones the file lacks
+    void copyTo(HikeTrack& track) const;
+
+private:
+    MappedFile file;
+    size_t pointCount{ 0 };
+    double originLongitude{ 0.0 };
+    double originLatitude{ 0.0 };
+
+    TrackSpan<glm::vec3> positions;
+    TrackSpan<double> times;
+    TrackSpan<float> heartRates;
+    TrackSpan<float> cadences;
+    TrackSpan<float> temperatures;
+
+    // Compressed columns, decoded
+    std::vector<glm::vec3> decodedPositions;
+    std::vector<double> decodedTimes;
+};
@@ -0,0 +1,103 @@
+// trail_index.cpp
+#include "trail_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void TrailIndex::clear() {
+    pointsXZ.clear();
+    cellStart.clear();
+    pointIndices.clear();
+    influenced.clear();
+    cellsX = cellsZ = 0;
+}
+
+void TrailIndex::build(const std::vector<glm::vec3>& points, float size) {
+    clear();
+    if (points.empty() || size <= 0.0f) {
+        return;
+    }
+
+    cellSize = size;
+    pointsXZ.reserve(points.size());
+
+    glm::vec2 minBounds(std::numeric_limits<float>::max());
+    glm::vec2 maxBounds(std::numeric_limits<float>::lowest());
+    for (const auto& point : points) {
+        glm::vec2 xz(point.x, point.z);
+        pointsXZ.push_back(xz);
+        minBounds = glm::min(minBounds, xz);
+        maxBounds = glm::max(maxBounds, xz);
+    }
+
+    // Pad by one cell on every side so the neighbours of occupied cells
+    // are still inside the grid
+    origin = minBounds - glm::vec2(cellSize);
+    cellsX = static_cast<int>(std::floor((maxBounds.x - origin.x) / cellSize)) + 2;
+    cellsZ = static_cast<int>(std::floor((maxBounds.y - origin.y) / cellSize)) + 2;
+
+    // Counting sort of the points into their cells
+    std::vector<int> pointCell(pointsXZ.size());
+    cellStart.assign(static_cast<size_t>(cellsX) * cellsZ + 1, 0);
+    for (size_t i = 0; i < pointsXZ.size(); ++i) {
+        glm::ivec2 cell = cellOf(pointsXZ[i]);
+        pointCell[i] = cell.y * cellsX + cell.x;
+        ++cellStart[pointCell[i] + 1];
+    }
+    for (size_t c = 1; c < cellStart.size(); ++c) {
+        cellStart[c] += cellStart[c - 1];
+    }
+
+    pointIndices.resize(pointsXZ.size());
+    std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < pointsXZ.size(); ++i) {
+        pointIndices[fill[pointCell[i]]++] = static_cast<int>(i);
+    }
+
+    // Mark every occupied cell and its 8 neighbours
+    influenced.assign(static_cast<size_t>(cellsX) * cellsZ, 0);
+    for (int cz = 0; cz < cellsZ; ++cz) {
+        for (int cx = 0; cx < cellsX; ++cx) {
+            int c = cz * cellsX + cx;
+            if (cellStart[c] == cellStart[c + 1]) continue;
+            for (int dz = -1; dz <= 1; ++dz) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    influenced[(cz + dz) * cellsX + (cx + dx)] = 1;
+                }
+            }
+        }
+    }
+}
+
+glm::ivec2 TrailIndex::cellOf(const glm::vec2& pos) const {
+    return glm::ivec2(static_cast<int>(std::floor((pos.x - origin.x) / cellSize)),
+        static_cast<int>(std::floor((pos.y - origin.y) / cellSize)));
+}
+
+int TrailIndex::findLastWithin(const glm::vec2& pos, float radius) const {
+    if (pointsXZ.empty()) return -1;
+
+    glm::ivec2 lo = cellOf(pos - glm::vec2(radius));
+    glm::ivec2 hi = cellOf(pos + glm::vec2(radius));
+    lo.x = std::max(lo.x, 0);
+    lo.y = std::max(lo.y, 0);
+    hi.x = std::min(hi.x, cellsX - 1);
+    hi.y = std::min(hi.y, cellsZ - 1);
+
+    int last = -1;
+    for (int cz = lo.y; cz <= hi.y; ++cz) {
+        for (int cx = lo.x; cx <= hi.x; ++cx) {
+            int c = cz * cellsX + cx;
+            // Walk backwards: the first hit is the latest point in this cell
+            for (int k = cellStart[c + 1] - 1; k >= cellStart[c]; --k) {
+                int i = pointIndices[k];
+                if (i <= last) break;
+                if (glm::distance(pos, pointsXZ[i]) < radius) {
+                    last = i;
+                    break;
+                }
+            }
+        }
+    }
+    return last;
+}
@@ -0,0 +1,49 @@
+// trail_index.h
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+// Uniform grid over the XZ footprint of a hiking trail. Points are bucketed
+// into square cells so radius queries only visit the cells they overlap.
+class TrailIndex {
+public:
+    // Cell size should be at least the query radius used with forEachInfluencedCell
+    void build(const std::vector<glm::vec3>& points, float cellSize);
+    void clear();
+
+    bool empty() const { return pointsXZ.empty(); }
+    float getCellSize() const { return cellSize; }
+
+    // Cell coordinate containing a world XZ position (may be outside the grid)
+    glm::ivec2 cellOf(const glm::vec2& pos) const;
+
+    // Index of the last point (in trail order) closer than radius to pos, or -1
+    int findLastWithin(const glm::vec2& pos, float radius) const;
+
+    // Calls fn(cell, cellMin, cellMax) once for every cell that holds a point
+    // or touches one that does. With radius <= cellSize these are the only
+    // cells that can contain positions within radius of the trail.
+    template<typename Fn>
+    void forEachInfluencedCell(Fn&& fn) const {
+        for (int cz = 0; cz < cellsZ; ++cz) {
+            for (int cx = 0; cx < cellsX; ++cx) {
+                if (!influenced[cz * cellsX + cx]) continue;
+                glm::vec2 cellMin = origin + glm::vec2(static_cast<float>(cx), static_cast<float>(cz)) * cellSize;
+                fn(glm::ivec2(cx, cz), cellMin, cellMin + glm::vec2(cellSize));
+            }
+        }
+    }
+
+private:
+    std::vector<glm::vec2> pointsXZ;
+    glm::vec2 origin{ 0.0f };
+    float cellSize{ 1.0f };
+    int cellsX{ 0 };
+    int cellsZ{ 0 };
+
+    // Bucketed point indices: cell c owns pointIndices[cellStart[c] .. cellStart[c + 1])
+    // Indices within a cell are ascending, i.e. in trail order.
+    std::vector<int> cellStart;
+    std::vector<int> pointIndices;
+    std::vector<unsigned char> influenced;
+};
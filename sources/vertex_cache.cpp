@@ -0,0 +1,210 @@
+// vertex_cache.cpp
+#include "vertex_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+    // Scoring constants from the paper
+    constexpr float CACHE_DECAY_POWER = 1.5f;
+    constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+    constexpr float VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+    template <typename Index>
+    size_t countMisses(const Index* indices, size_t indexCount, int cacheSize, VertexCacheModel model) {
+        // Small enough that a linear scan beats any lookup structure
+        std::vector<Index> cache;
+        cache.reserve(cacheSize);
+        size_t fifoNext = 0;
+        size_t misses = 0;
+
+        for (size_t i = 0; i < indexCount; ++i) {
+            Index index = indices[i];
+            auto it = std::find(cache.begin(), cache.end(), index);
+            if (it != cache.end()) {
+                // A hit only reorders an LRU cache
+                if (model == VertexCacheModel::Lru) {
+                    std::rotate(cache.begin(), it, it + 1);
+                }
+                continue;
+            }
+
+            ++misses;
+            if (model == VertexCacheModel::Lru) {
+                if (static_cast<int>(cache.size()) < cacheSize) {
+                    cache.push_back(index);
+                }
+                else {
+                    cache.back() = index;
+                }
+                std::rotate(cache.begin(), cache.end() - 1, cache.end());
+            }
+            else if (static_cast<int>(cache.size()) < cacheSize) {
+                cache.push_back(index);
+            }
+            else {
+                cache[fifoNext] = index;
+                fifoNext = (fifoNext + 1) % cacheSize;
+            }
+        }
+        return misses;
+    }
+
+    // Valences beyond this share the last table entry
+    constexpr int MAX_VALENCE_SCORED = 32;
+
+    // The score terms only depend on small integers, so they are tabulated
+    // once per call instead of calling pow for every update
+    struct ScoreTable {
+        std::vector<float> cache;       // By cache position
+        float valence[MAX_VALENCE_SCORED + 1];
+
+        explicit ScoreTable(int cacheSize) : cache(cacheSize) {
+            for (int position = 0; position < cacheSize; ++position) {
+                // Used by the last triangle: fixed score so it is not simply reused
+                cache[position] = position < 3 ? LAST_TRIANGLE_SCORE
+                    : std::pow(1.0f - (position - 3) / static_cast<float>(cacheSize - 3), CACHE_DECAY_POWER);
+            }
+            // Finishing off vertices with few triangles left frees the cache sooner
+            valence[0] = 0.0f;
+            for (int count = 1; count <= MAX_VALENCE_SCORED; ++count) {
+                valence[count] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(count), -VALENCE_BOOST_POWER);
+            }
+        }
+
+        float vertexScore(int cachePosition, int trianglesLeft) const {
+            if (trianglesLeft == 0) return -1.0f;
+            return (cachePosition >= 0 ? cache[cachePosition] : 0.0f)
+                + valence[std::min(trianglesLeft, MAX_VALENCE_SCORED)];
+        }
+    };
+
+    template <typename Index>
+    void optimize(Index* indices, size_t indexCount, int cacheSize) {
+        const size_t triangleCount = indexCount / 3;
+        if (triangleCount < 2) return;
+        cacheSize = std::max(cacheSize, 4);
+
+        // Work on compact local vertex ids; the indices may reference a
+        // small part of a much larger vertex buffer
+        std::vector<Index> uniqueIndices(indices, indices + triangleCount * 3);
+        std::sort(uniqueIndices.begin(), uniqueIndices.end());
+        uniqueIndices.erase(std::unique(uniqueIndices.begin(), uniqueIndices.end()), uniqueIndices.end());
+        const size_t vertexCount = uniqueIndices.size();
+
+        std::vector<int> local(triangleCount * 3);
+        for (size_t i = 0; i < local.size(); ++i) {
+            local[i] = static_cast<int>(std::lower_bound(uniqueIndices.begin(), uniqueIndices.end(), indices[i]) - uniqueIndices.begin());
+        }
+
+        // Triangles of each vertex, compressed row storage
+        std::vector<int> trianglesLeft(vertexCount, 0);
+        for (int v : local) ++trianglesLeft[v];
+        std::vector<int> adjacencyStart(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            adjacencyStart[v + 1] = adjacencyStart[v] + trianglesLeft[v];
+        }
+        std::vector<int> adjacency(adjacencyStart.back());
+        {
+            std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for (size_t i = 0; i < local.size(); ++i) {
+                adjacency[fill[local[i]]++] = static_cast<int>(i / 3);
+            }
+        }
+
+        const ScoreTable table(cacheSize);
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> score(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            score[v] = table.vertexScore(-1, trianglesLeft[v]);
+        }
+
+        std::vector<char> emitted(triangleCount, 0);
+
+        std::vector<int> cache;
+        std::vector<int> nextCache;
+        cache.reserve(cacheSize + 3);
+        nextCache.reserve(cacheSize + 3);
+        std::vector<Index> output;
+        output.reserve(triangleCount * 3);
+
+        int best = 0;
+        size_t scanCursor = 0;
+        for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+            if (best < 0) {
+                // Nothing left around the cache: take the next unused triangle.
+                // Triangles are mostly emitted near the cursor, so this stays linear.
+                while (emitted[scanCursor]) ++scanCursor;
+                best = static_cast<int>(scanCursor);
+            }
+
+            emitted[best] = 1;
+            const int* triangle = &local[best * 3];
+            for (int k = 0; k < 3; ++k) {
+                output.push_back(indices[best * 3 + k]);
+
+                // Drop the triangle from its vertices' remaining lists
+                int v = triangle[k];
+                int* begin = &adjacency[adjacencyStart[v]];
+                int* end = begin + trianglesLeft[v];
+                std::iter_swap(std::find(begin, end, best), end - 1);
+                --trianglesLeft[v];
+            }
+
+            // The new triangle's vertices move to the front of the cache
+            nextCache.assign(triangle, triangle + 3);
+            for (int v : cache) {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                    nextCache.push_back(v);
+                }
+            }
+            std::swap(cache, nextCache);
+
+            for (size_t i = 0; i < cache.size(); ++i) {
+                int v = cache[i];
+                cachePosition[v] = i < static_cast<size_t>(cacheSize) ? static_cast<int>(i) : -1;
+                score[v] = table.vertexScore(cachePosition[v], trianglesLeft[v]);
+            }
+
+            // Rescore the triangles around the cache and pick the best
+            best = -1;
+            float bestScore = -1.0f;
+            for (int v : cache) {
+                for (int a = adjacencyStart[v]; a < adjacencyStart[v] + trianglesLeft[v]; ++a) {
+                    int t = adjacency[a];
+                    float s = score[local[t * 3]] + score[local[t * 3 + 1]] + score[local[t * 3 + 2]];
+                    if (s > bestScore) {
+                        bestScore = s;
+                        best = t;
+                    }
+                }
+            }
+
+            // Vertices pushed past the end are out of the cache for good
+            if (cache.size() > static_cast<size_t>(cacheSize)) {
+                cache.resize(cacheSize);
+            }
+        }
+
+        std::copy(output.begin(), output.end(), indices);
+    }
+}
+
+size_t countVertexCacheMisses(const unsigned int* indices, size_t indexCount,
+    int cacheSize, VertexCacheModel model) {
+    return countMisses(indices, indexCount, cacheSize, model);
+}
+
+size_t countVertexCacheMisses(const unsigned short* indices, size_t indexCount,
+    int cacheSize, VertexCacheModel model) {
+    return countMisses(indices, indexCount, cacheSize, model);
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, int cacheSize) {
+    optimize(indices, indexCount, cacheSize);
+}
+
+void optimizeVertexCache(unsigned short* indices, size_t indexCount, int cacheSize) {
+    optimize(indices, indexCount, cacheSize);
+}
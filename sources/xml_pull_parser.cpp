@@ -0,0 +1,150 @@
+// xml_pull_parser.cpp
+#include "xml_pull_parser.h"
+
+namespace {
+    inline bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    inline bool startsWith(const char* position, const char* end, const char* prefix, size_t length) {
+        return static_cast<size_t>(end - position) >= length && std::memcmp(position, prefix, length) == 0;
+    }
+}
+
+XmlPullParser::XmlPullParser(const char* data, size_t size)
+    : documentBegin(data), documentEnd(data + size), position(data) {
+}
+
+XmlPullParser::Event XmlPullParser::next() {
+    if (error) return Event::Error;
+    if (pendingEnd) {
+        pendingEnd = false;
+        return Event::EndElement;
+    }
+
+    for (;;) {
+        if (position >= documentEnd) return Event::EndOfDocument;
+
+        if (*position != '<') {
+            const char* start = position;
+            const void* tag = std::memchr(position, '<', static_cast<size_t>(documentEnd - position));
+            position = tag ? static_cast<const char*>(tag) : documentEnd;
+            text = { start, position };
+            return Event::Text;
+        }
+
+        if (startsWith(position, documentEnd, "<!--", 4)) {
+            if (!skipPast("-->")) return fail("Unterminated comment");
+            continue;
+        }
+        if (startsWith(position, documentEnd, "<![CDATA[", 9)) {
+            const char* start = position + 9;
+            if (!skipPast("]]>")) return fail("Unterminated CDATA section");
+            text = { start, position - 3 };
+            return Event::Text;
+        }
+        if (startsWith(position, documentEnd, "<?", 2)) {
+            if (!skipPast("?>")) return fail("Unterminated processing instruction");
+            continue;
+        }
+        if (startsWith(position, documentEnd, "<!", 2)) {
+            // DOCTYPE, with an internal subset in brackets that may hold '>'
+            int depth = 0;
+            const char* p = position + 2;
+            for (; p < documentEnd; ++p) {
+                if (*p == '[') ++depth;
+                else if (*p == ']') --depth;
+                else if (*p == '>' && depth <= 0) break;
+            }
+            if (p >= documentEnd) return fail("Unterminated declaration");
+            position = p + 1;
+            continue;
+        }
+
+        if (startsWith(position, documentEnd, "</", 2)) {
+            const char* start = position + 2;
+            const void* close = std::memchr(start, '>', static_cast<size_t>(documentEnd - start));
+            if (!close) return fail("Unterminated end tag");
+            const char* nameEnd = start;
+            while (nameEnd < close && !isSpace(*nameEnd)) ++nameEnd;
+            name = { start, nameEnd };
+            position = static_cast<const char*>(close) + 1;
+            return Event::EndElement;
+        }
+
+        // Start tag; quoted attribute values may hold '>'
+        const char* start = position + 1;
+        const char* nameEnd = start;
+        while (nameEnd < documentEnd && !isSpace(*nameEnd) && *nameEnd != '>' && *nameEnd != '/') ++nameEnd;
+        if (nameEnd == start) return fail("Element without a name");
+        const char* p = nameEnd;
+        char quote = 0;
+        for (; p < documentEnd; ++p) {
+            if (quote) {
+                if (*p == quote) quote = 0;
+            }
+            else if (*p == '"' || *p == '\'') {
+                quote = *p;
+            }
+            else if (*p == '>') {
+                break;
+            }
+        }
+        if (p >= documentEnd) return fail("Unterminated start tag");
+
+        pendingEnd = p[-1] == '/';
+        name = { start, nameEnd };
+        attributes = { nameEnd, pendingEnd ? p - 1 : p };
+        position = p + 1;
+        return Event::StartElement;
+    }
+}
+
+XmlSpan XmlPullParser::getLocalName() const {
+    XmlSpan local = name;
+    for (const char* p = name.begin; p < name.end; ++p) {
+        if (*p == ':') local.begin = p + 1;
+    }
+    return local;
+}
+
+bool XmlPullParser::getAttribute(const char* attributeName, XmlSpan& value) const {
+    const size_t nameLength = std::strlen(attributeName);
+    const char* p = attributes.begin;
+    const char* end = attributes.end;
+    while (p < end) {
+        while (p < end && isSpace(*p)) ++p;
+        const char* start = p;
+        while (p < end && *p != '=' && !isSpace(*p)) ++p;
+        const char* attributeEnd = p;
+        while (p < end && (isSpace(*p) || *p == '=')) ++p;
+        if (p >= end || (*p != '"' && *p != '\'')) return false;
+
+        const char quote = *p++;
+        const char* valueBegin = p;
+        while (p < end && *p != quote) ++p;
+        if (static_cast<size_t>(attributeEnd - start) == nameLength &&
+            std::memcmp(start, attributeName, nameLength) == 0) {
+            value = { valueBegin, p };
+            return true;
+        }
+        ++p;
+    }
+    return false;
+}
+
+XmlPullParser::Event XmlPullParser::fail(const char* message) {
+    error = message;
+    return Event::Error;
+}
+
+bool XmlPullParser::skipPast(const char* terminator) {
+    const size_t length = std::strlen(terminator);
+    for (const char* p = position; static_cast<size_t>(documentEnd - p) >= length; ++p) {
+        if (std::memcmp(p, terminator, length) == 0) {
+            position = p + length;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+// xml_pull_parser.h
+#pragma once
+#include <cstddef>
+#include <cstring>
+
+// Characters [begin, end) of the parsed document; not null-terminated
+struct XmlSpan {
+    const char* begin{ nullptr };
+    const char* end{ nullptr };
+
+    size_t size() const { return static_cast<size_t>(end - begin); }
+    bool empty() const { return begin == end; }
+    bool equals(const char* text) const {
+        size_t length = std::strlen(text);
+        return size() == length && std::memcmp(begin, text, length) == 0;
+    }
+};
+
+// Pull parser over an XML document in memory: every next() moves to the
+// following element start, element end or run of text, and nothing is
+// kept but the position, so memory use does not grow with the document.
+// Names, attribute values and text are spans into the document, with
+// entities left as they are. Declarations, comments and DOCTYPEs are
+// skipped; CDATA sections come as text. Only well-formedness needed to
+// find the tags is checked: mismatched end tags go unnoticed.
+class XmlPullParser {
+public:
+    enum class Event { StartElement, EndElement, Text, EndOfDocument, Error };
+
+    XmlPullParser(const char* data, size_t size);
+
+    Event next();
+
+    // Of the current element start or end; "gpxtpx:hr" has local name "hr"
+    XmlSpan getName() const { return name; }
+    XmlSpan getLocalName() const;
+
+    // Value of an attribute of the current element start; false if it has none
+    bool getAttribute(const char* attributeName, XmlSpan& value) const;
+
+    // Of the current text event
+    XmlSpan getText() const { return text; }
+
+    size_t getOffset() const { return static_cast<size_t>(position - documentBegin); }
+    const char* getError() const { return error; }
+
+private:
+    const char* documentBegin;
+    const char* documentEnd;
+    const char* position;
+
+    XmlSpan name;
+    XmlSpan attributes;     // Between the name and the end of the start tag
+    XmlSpan text;
+    bool pendingEnd{ false };   // The start just returned closed itself: <name/>
+    const char* error{ nullptr };
+
+    Event fail(const char* message);
+    bool skipPast(const char* terminator);
+};